@@ -6,12 +6,47 @@ LOCAL_MODULE := uidump-parser
 
 LOCAL_SRC_FILES := \
 	src/main.cpp \
+    src/alloc_stats.cpp \
+    src/archive.cpp \
+    src/benchmark.cpp \
+    src/bloom_index.cpp \
+    src/bounds.cpp \
+    src/checkpoint.cpp \
+    src/debug.cpp \
+    src/difftest.cpp \
+    src/engine.cpp \
+    src/grid.cpp \
+    src/identify.cpp \
+    src/inputs.cpp \
+    src/lint.cpp \
+    src/mapped_file.cpp \
+    src/memmem.cpp \
+    src/order.cpp \
+    src/parallel.cpp \
+    src/partial.cpp \
+    src/prefilter.cpp \
+    src/progress.cpp \
+    src/query.cpp \
+    src/query_plan.cpp \
+    src/radix.cpp \
+    src/replay.cpp \
+    src/scaling.cpp \
+    src/schema.cpp \
+    src/search.cpp \
+    src/self_bench.cpp \
+    src/spatial.cpp \
+    src/stitch.cpp \
+    src/synthetic.cpp \
+    src/tape.cpp \
+    src/text_dump.cpp \
     src/tinyxml2/tinyxml2.cpp
 
 LOCAL_CFLAGS += \
     -Wno-pointer-sign \
     -Wno-int-to-pointer-cast
 
+LOCAL_LDLIBS += -lz
+
 include $(BUILD_EXECUTABLE)
 
 $(call import-add-path, $(LOCAL_PATH))
\ No newline at end of file
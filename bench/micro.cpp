@@ -0,0 +1,371 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks for the kernels the parser and the finders spend
+// their time in, each run on synthetic input so a replacement can be
+// judged on its own. Build and run with `make bench`.
+
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "query.h"
+#include "schema.h"
+#include "search.h"
+#include "synthetic.h"
+#include "tape.h"
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+namespace {
+
+// Accepts and drops everything, so the finders pay for formatting
+// their matches but not for storing them.
+class NullBuffer : public std::streambuf {
+  protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) override {
+        return n;
+    }
+};
+
+std::string repeat(const std::string &s, size_t length) {
+    std::string out;
+    while (out.size() < length)
+        out += s;
+    out.resize(length);
+    return out;
+}
+
+void bench_skip_whitespace(std::ostream &out) {
+    std::string input = repeat("  \n\t    ", 4096) + "x";
+    BenchResult r = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            const char *p = XMLUtil::SkipWhiteSpace(input.c_str(), nullptr);
+            do_not_optimize(p);
+        }
+    });
+    print_bench_result(out, "XMLUtil::SkipWhiteSpace 4K", r, 4096);
+}
+
+void bench_parse_name(std::ostream &out) {
+    static const char *const names[] = {"index", "resource-id",
+                                        "content-desc", "long-clickable"};
+    for (const char *name : names) {
+        std::string input = std::string(name) + "=\"\"";
+        std::vector<char> buffer(input.begin(), input.end());
+        buffer.push_back('\0');
+        BenchResult r = run_benchmark([&](uint64_t n) {
+            StrPair pair;
+            for (uint64_t i = 0; i < n; ++i) {
+                char *p = pair.ParseName(buffer.data());
+                do_not_optimize(p);
+            }
+        });
+        std::string label = std::string("StrPair::ParseName ") + name;
+        print_bench_result(out, label.c_str(), r, strlen(name));
+    }
+}
+
+void bench_parse_text(std::ostream &out) {
+    static const size_t lengths[] = {8, 64, 1024};
+    for (size_t length : lengths) {
+        std::string input = repeat("Item 42 and more ", length) + "\" x";
+        std::vector<char> buffer(input.begin(), input.end());
+        buffer.push_back('\0');
+        BenchResult r = run_benchmark([&](uint64_t n) {
+            StrPair pair;
+            int line = 1;
+            for (uint64_t i = 0; i < n; ++i) {
+                char *p = pair.ParseText(buffer.data(), "\"",
+                                         StrPair::ATTRIBUTE_VALUE, &line);
+                do_not_optimize(p);
+            }
+        });
+        std::string label =
+            "StrPair::ParseText " + std::to_string(length) + "B";
+        print_bench_result(out, label.c_str(), r, length);
+    }
+}
+
+// GetStr rewrites its buffer in place, so every operation first
+// restores the input; the memcpy row is that cost on its own.
+void bench_get_str(std::ostream &out) {
+    struct Case {
+        const char *label;
+        std::string text;
+    };
+    const Case cases[] = {
+        {"StrPair::GetStr plain 64B", repeat("Item 42 and more ", 64)},
+        {"StrPair::GetStr entities 64B",
+         repeat("Item &amp; &quot;more&quot; &lt;b&gt; ", 64)},
+        {"StrPair::GetStr plain 1K", repeat("Item 42 and more ", 1024)},
+        {"StrPair::GetStr entities 1K",
+         repeat("Item &amp; &quot;more&quot; &lt;b&gt; ", 1024)},
+    };
+    for (const Case &c : cases) {
+        size_t length = c.text.size();
+        std::vector<char> buffer(length + 1);
+        BenchResult copy = run_benchmark([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                memcpy(buffer.data(), c.text.data(), length);
+                do_not_optimize(buffer[0]);
+            }
+        });
+        BenchResult r = run_benchmark([&](uint64_t n) {
+            StrPair pair;
+            for (uint64_t i = 0; i < n; ++i) {
+                memcpy(buffer.data(), c.text.data(), length);
+                pair.Set(buffer.data(), buffer.data() + length,
+                         StrPair::ATTRIBUTE_VALUE);
+                const char *s = pair.GetStr();
+                do_not_optimize(s);
+            }
+        });
+        std::string label =
+            std::string("  memcpy baseline ") + std::to_string(length) + "B";
+        print_bench_result(out, label.c_str(), copy, length);
+        print_bench_result(out, c.label, r, length);
+    }
+}
+
+void bench_find_attribute(std::ostream &out, const XMLElement *node) {
+    static const char *const names[] = {"index", "class", "bounds",
+                                        "missing"};
+    for (const char *name : names) {
+        BenchResult r = run_benchmark([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                const XMLAttribute *a = node->FindAttribute(name);
+                do_not_optimize(a);
+            }
+        });
+        std::string label = std::string("XMLElement::FindAttribute ") + name;
+        print_bench_result(out, label.c_str(), r);
+    }
+}
+
+// ParseAttributes is private, so it is measured through whole parses
+// of the same nodes with and without their attributes.
+void bench_parse_attributes(std::ostream &out) {
+    const unsigned nodes = 256;
+    std::string bare = "<hierarchy>", full = "<hierarchy>";
+    for (unsigned i = 0; i < nodes; ++i) {
+        bare += "<node />";
+        full += "<node index=\"0\" text=\"Item 42\" "
+                "resource-id=\"com.example.app:id/title\" "
+                "class=\"android.widget.TextView\" "
+                "package=\"com.example.app\" content-desc=\"\" "
+                "checkable=\"false\" checked=\"false\" clickable=\"false\" "
+                "enabled=\"true\" focusable=\"false\" focused=\"false\" "
+                "scrollable=\"false\" long-clickable=\"false\" "
+                "password=\"false\" selected=\"false\" "
+                "bounds=\"[40,420][700,500]\" />";
+    }
+    bare += "</hierarchy>";
+    full += "</hierarchy>";
+
+    XMLDocument doc;
+    auto parse = [&](const std::string &xml) {
+        return run_benchmark([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                doc.Parse(xml.c_str(), xml.size());
+        });
+    };
+    BenchResult without = parse(bare);
+    BenchResult with = parse(full);
+    print_bench_result(out, "  XMLDocument::Parse 256 bare nodes", without,
+                       bare.size());
+    print_bench_result(out, "XMLDocument::Parse 256 x 17 attrs", with,
+                       full.size());
+    BenchResult per_node = with;
+    per_node.ns_per_op = (with.ns_per_op - without.ns_per_op) / nodes;
+    per_node.ci95 = (with.ci95 + without.ci95) / nodes;
+    print_bench_result(out, "XMLElement::ParseAttributes per node",
+                       per_node, (full.size() - bare.size()) / nodes);
+
+    doc.SetLazyAttributes(true);
+    BenchResult lazy = parse(full);
+    print_bench_result(out, "XMLDocument::Parse 256 x 17 attrs lazy", lazy,
+                       full.size());
+}
+
+void bench_parsers(std::ostream &out) {
+    SyntheticSpec spec;
+    spec.rows = 200;
+    std::string xml = synthetic_dump(spec);
+
+    XMLDocument doc;
+    BenchResult dom = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i)
+            doc.Parse(xml.c_str(), xml.size());
+    });
+    print_bench_result(out, "  XMLDocument::Parse 200 rows", dom, xml.size());
+
+    XMLDocument lazy_doc;
+    lazy_doc.SetLazyAttributes(true);
+    BenchResult lazy = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i)
+            lazy_doc.Parse(xml.c_str(), xml.size());
+    });
+    print_bench_result(out, "  XMLDocument::Parse 200 rows lazy", lazy,
+                       xml.size());
+
+    std::vector<uint64_t> bits(xml.size() / 64);
+    BenchResult index = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            structural_index(xml.data(), bits.size(), bits.data());
+            do_not_optimize(bits.data());
+        }
+    });
+    print_bench_result(out, "structural_index 200 rows", index,
+                       bits.size() * 64);
+
+    Tape tape;
+    BenchResult parse = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            bool ok = tape.parse(xml.data(), xml.size());
+            do_not_optimize(ok);
+        }
+    });
+    print_bench_result(out, "Tape::parse 200 rows", parse, xml.size());
+
+    SchemaDump dump;
+    BenchResult schema = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            bool ok = dump.parse(xml.data(), xml.size());
+            do_not_optimize(ok);
+        }
+    });
+    print_bench_result(out, "SchemaDump::parse 200 rows", schema, xml.size());
+}
+
+void bench_mem_pool(std::ostream &out) {
+    MemPoolT<sizeof(XMLElement)> pool;
+    BenchResult pair = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            void *p = pool.Alloc();
+            do_not_optimize(p);
+            pool.Free(p);
+        }
+    });
+    print_bench_result(out, "MemPoolT::Alloc+Free", pair);
+
+    std::vector<void *> items(1024);
+    BenchResult batch = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) {
+            for (auto &p : items)
+                p = pool.Alloc();
+            for (auto p : items)
+                pool.Free(p);
+        }
+    });
+    batch.ns_per_op /= items.size();
+    batch.ci95 /= items.size();
+    print_bench_result(out, "MemPoolT::Alloc+Free 1024 deep", batch);
+}
+
+void bench_finders(std::ostream &out) {
+    SyntheticSpec spec;
+    spec.rows = 200;
+    std::string xml = synthetic_dump(spec);
+    XMLDocument doc;
+    doc.Parse(xml.c_str(), xml.size());
+    const XMLElement *root = doc.RootElement();
+
+    NullBuffer null_buffer;
+    std::ostream sink(&null_buffer);
+
+    Query query;
+    std::string error;
+    query.compile("class=android.widget.TextView && text~Item", error);
+    QueryProgram program = query.program();
+
+    struct Finder {
+        const char *label;
+        std::function<void()> run;
+    };
+    const Finder finders[] = {
+        {"find_node_by_resource_id",
+         [&] {
+             find_node_by_resource_id(sink, root, "com.example.app:id/price",
+                                      nullptr);
+         }},
+        {"find_node_by_class",
+         [&] {
+             find_node_by_class(sink, root, "android.widget.ImageView",
+                                nullptr);
+         }},
+        {"find_node_by_text",
+         [&] { find_node_by_text(sink, root, "Email", nullptr); }},
+        {"find_node_by_query",
+         [&] { find_node_by_query(sink, root, program, nullptr); }},
+        {"find_node_by_filter",
+         [&] {
+             find_node_by_filter(sink, root, "content-desc", "Add to cart",
+                                 nullptr);
+         }},
+    };
+    for (const Finder &finder : finders) {
+        BenchResult r = run_benchmark([&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                finder.run();
+        });
+        std::string label = std::string(finder.label) + " 200 rows";
+        print_bench_result(out, label.c_str(), r, xml.size());
+    }
+
+    XMLDocument interned;
+    interned.SetInternedAttributes(LOW_CARDINALITY_ATTRIBUTES);
+    interned.Parse(xml.c_str(), xml.size());
+    QueryInterner interner;
+    const QueryInterning *interning = interner.resolve(program, interned);
+    BenchResult r = run_benchmark([&](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i)
+            find_node_by_query(sink, interned.RootElement(), program, nullptr,
+                               "", "", interning);
+    });
+    print_bench_result(out, "find_node_by_query interned 200 rows", r,
+                       xml.size());
+}
+
+} // namespace
+
+int main() {
+    std::ostream &out = std::cout;
+    out << "Indented rows are baselines for the row below them.\n";
+    bench_skip_whitespace(out);
+    bench_parse_name(out);
+    bench_parse_text(out);
+    bench_get_str(out);
+
+    XMLDocument doc;
+    std::string xml = synthetic_dump(SyntheticSpec());
+    doc.Parse(xml.c_str(), xml.size());
+    const XMLElement *node = doc.RootElement()->FirstChildElement("node");
+    bench_find_attribute(out, node);
+
+    bench_parse_attributes(out);
+    bench_parsers(out);
+    bench_mem_pool(out);
+    bench_finders(out);
+    return 0;
+}
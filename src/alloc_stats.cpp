@@ -0,0 +1,131 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "alloc_stats.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "tinyxml2/tinyxml2.h"
+
+namespace {
+
+// Off unless a run asks for the numbers, so the allocator of an ordinary
+// run only pays for a load of a flag that is never written to again,
+// not for atomic adds on lines every thread shares.
+std::atomic<bool> counting(false);
+std::atomic<uint64_t> allocations(0);
+std::atomic<uint64_t> frees(0);
+std::atomic<uint64_t> bytes(0);
+std::atomic<uint64_t> pool_items(0);
+std::atomic<uint64_t> pool_blocks(0);
+
+void *counted_alloc(size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    return malloc(size ? size : 1);
+}
+
+void counted_free(void *pointer) {
+    if (!pointer)
+        return;
+    if (counting.load(std::memory_order_relaxed))
+        frees.fetch_add(1, std::memory_order_relaxed);
+    free(pointer);
+}
+
+void count_pool_item(size_t) {
+    pool_items.fetch_add(1, std::memory_order_relaxed);
+}
+
+void count_pool_block(size_t) {
+    pool_blocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void start_alloc_stats() {
+    tinyxml2::memPoolHooks.itemAlloc = count_pool_item;
+    tinyxml2::memPoolHooks.blockAlloc = count_pool_block;
+    counting.store(true, std::memory_order_relaxed);
+}
+
+void *operator new(size_t size) {
+    void *pointer = counted_alloc(size);
+    if (!pointer)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return counted_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return counted_alloc(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    counted_free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    counted_free(pointer);
+}
+
+AllocStats alloc_stats() {
+    AllocStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.frees = frees.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.pool_items = pool_items.load(std::memory_order_relaxed);
+    stats.pool_blocks = pool_blocks.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void print_alloc_stats(std::ostream &out, const AllocStats &stats) {
+    out << "Allocations: " << stats.allocations << " (" << stats.bytes
+        << " bytes), frees: " << stats.frees
+        << ", pool items: " << stats.pool_items
+        << ", pool blocks: " << stats.pool_blocks << "\n";
+}
+
+uint64_t steady_state_allocations(const std::function<void()> &fn,
+                                  unsigned warmup, unsigned iterations) {
+    start_alloc_stats();
+    for (unsigned i = 0; i < warmup; i++)
+        fn();
+    uint64_t before = allocations.load(std::memory_order_relaxed);
+    for (unsigned i = 0; i < iterations; i++)
+        fn();
+    return allocations.load(std::memory_order_relaxed) - before;
+}
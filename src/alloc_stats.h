@@ -0,0 +1,52 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_ALLOC_STATS_H
+#define UIDUMP_ALLOC_STATS_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// Heap activity of the whole process since start_alloc_stats. The global
+// operator new and delete are replaced to count every allocation, and
+// the tinyxml2 pools report the nodes they hand out and the blocks they
+// grow by. Memory allocated before counting started may show up as frees
+// only.
+struct AllocStats {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes; // requested by the allocations above
+    uint64_t pool_items;
+    uint64_t pool_blocks;
+};
+
+// Starts counting; until then operator new and delete only check a flag.
+// Call it before starting any worker threads.
+void start_alloc_stats();
+
+AllocStats alloc_stats();
+
+void print_alloc_stats(std::ostream &out, const AllocStats &stats);
+
+// Runs fn warmup times so caches and buffers reach their steady size,
+// then returns how many heap allocations iterations more runs made.
+// Starts counting if nothing has yet.
+uint64_t steady_state_allocations(const std::function<void()> &fn,
+                                  unsigned warmup, unsigned iterations);
+
+#endif // UIDUMP_ALLOC_STATS_H
@@ -0,0 +1,353 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "archive.h"
+
+#include <cstring>
+
+#include "inputs.h"
+
+static bool has_suffix(const std::string &name, const char *suffix) {
+    size_t length = strlen(suffix);
+    return name.size() > length &&
+           name.compare(name.size() - length, length, suffix) == 0;
+}
+
+ArchiveKind archive_kind(const std::string &path) {
+    if (has_suffix(path, ".zip"))
+        return ARCHIVE_ZIP;
+    if (has_suffix(path, ".tar") || has_suffix(path, ".tar.gz") ||
+        has_suffix(path, ".tgz"))
+        return ARCHIVE_TAR;
+    return ARCHIVE_NONE;
+}
+
+ArchiveBuffer::~ArchiveBuffer() {
+    if (inflating_)
+        inflateEnd(&stream_);
+}
+
+char *ArchiveBuffer::reserve(size_t size) {
+    if (data_.size() < size)
+        data_.resize(size);
+    size_ = size;
+    return data_.data();
+}
+
+TarReader::~TarReader() {
+    if (file_)
+        gzclose(file_);
+}
+
+bool TarReader::open(const std::string &path, std::string &error) {
+    file_ = gzopen(path.c_str(), "rb");
+    if (!file_) {
+        error = "could not open archive " + path;
+        return false;
+    }
+    gzbuffer(file_, 128 * 1024);
+    return true;
+}
+
+bool TarReader::skip(uint64_t size) {
+    char scratch[4096];
+    while (size > 0) {
+        unsigned chunk = size < sizeof(scratch) ? size : sizeof(scratch);
+        if (gzread(file_, scratch, chunk) != (int)chunk)
+            return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+// Numeric header fields are octal text, or big-endian binary when the
+// top bit of the first byte is set (GNU tar, for files over 8 GiB).
+static uint64_t tar_number(const char *field, size_t length) {
+    uint64_t value = 0;
+    if ((unsigned char)field[0] & 0x80) {
+        for (size_t i = 1; i < length; i++)
+            value = value << 8 | (unsigned char)field[i];
+        return value;
+    }
+    for (size_t i = 0; i < length && field[i]; i++) {
+        if (field[i] >= '0' && field[i] <= '7')
+            value = value * 8 + (field[i] - '0');
+    }
+    return value;
+}
+
+static std::string tar_string(const char *field, size_t length) {
+    return std::string(field, strnlen(field, length));
+}
+
+// Finds the path record of a pax extended header, "<len> path=<value>\n".
+static bool pax_path(const char *data, size_t size, std::string &path) {
+    size_t pos = 0;
+    while (pos < size) {
+        size_t length = 0, i = pos;
+        while (i < size && data[i] >= '0' && data[i] <= '9')
+            length = length * 10 + (data[i++] - '0');
+        if (length == 0 || pos + length > size)
+            return false;
+        const char *record = data + i + 1;
+        size_t record_length = pos + length - (i + 1);
+        if (record_length > 6 && memcmp(record, "path=", 5) == 0) {
+            path.assign(record + 5, record_length - 6);
+            return true;
+        }
+        pos += length;
+    }
+    return false;
+}
+
+bool TarReader::next(std::string &name, ArchiveBuffer &buffer,
+                     std::string &error) {
+    std::string long_name;
+    char header[512];
+    for (;;) {
+        int got = gzread(file_, header, sizeof(header));
+        if (got == 0)
+            return false;
+        if (got != (int)sizeof(header)) {
+            error = "truncated tar header";
+            return false;
+        }
+        if (header[0] == '\0')
+            return false; // end-of-archive block
+
+        uint64_t size = tar_number(header + 124, 12);
+        uint64_t padded = (size + 511) & ~(uint64_t)511;
+        char type = header[156];
+
+        if (type == 'L' || type == 'x') {
+            // GNU long name or pax header: both describe the next entry.
+            char *data = buffer.reserve(padded);
+            if (gzread(file_, data, padded) != (int)padded) {
+                error = "truncated tar entry";
+                return false;
+            }
+            if (type == 'L')
+                long_name = tar_string(data, size);
+            else
+                pax_path(data, size, long_name);
+            continue;
+        }
+
+        if (!long_name.empty()) {
+            name.swap(long_name);
+            long_name.clear();
+        } else {
+            name = tar_string(header + 0, 100);
+            if (memcmp(header + 257, "ustar", 5) == 0 && header[345]) {
+                name = tar_string(header + 345, 155) + "/" + name;
+            }
+        }
+
+        bool regular = type == '0' || type == '\0' || type == '7';
+        if (!regular || !has_xml_suffix(name)) {
+            if (!skip(padded)) {
+                error = "truncated tar entry";
+                return false;
+            }
+            continue;
+        }
+
+        char *data = buffer.reserve(padded);
+        if (gzread(file_, data, padded) != (int)padded) {
+            error = "truncated tar entry " + name;
+            return false;
+        }
+        buffer.size_ = size;
+        return true;
+    }
+}
+
+static uint16_t read16(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return u[0] | u[1] << 8;
+}
+
+static uint32_t read32(const char *p) {
+    return read16(p) | (uint32_t)read16(p + 2) << 16;
+}
+
+static uint64_t read64(const char *p) {
+    return read32(p) | (uint64_t)read32(p + 4) << 32;
+}
+
+bool ZipReader::open(const std::string &path, std::string &error) {
+    if (!file_.open(path.c_str())) {
+        error = "could not open archive " + path;
+        return false;
+    }
+    if (!read_directory(error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool ZipReader::read_directory(std::string &error) {
+    const char *data = file_.data();
+    size_t size = file_.size();
+
+    // The end record sits in the last 22 bytes plus up to 64 KiB of
+    // archive comment.
+    const size_t end_size = 22;
+    if (size < end_size) {
+        error = "not a zip archive";
+        return false;
+    }
+    size_t end = size - end_size, lowest = size > end_size + 65535
+                                                ? size - end_size - 65535
+                                                : 0;
+    while (read32(data + end) != 0x06054b50) {
+        if (end == lowest) {
+            error = "not a zip archive";
+            return false;
+        }
+        end--;
+    }
+
+    uint64_t count = read16(data + end + 10);
+    uint64_t directory = read32(data + end + 16);
+    if ((count == 0xffff || directory == 0xffffffff) && end >= 20 &&
+        read32(data + end - 20) == 0x07064b50) {
+        uint64_t end64 = read64(data + end - 20 + 8);
+        if (end64 + 56 > size || read32(data + end64) != 0x06064b50) {
+            error = "bad zip64 end record";
+            return false;
+        }
+        count = read64(data + end64 + 32);
+        directory = read64(data + end64 + 48);
+    }
+
+    uint64_t pos = directory;
+    entries_.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        if (pos + 46 > size || read32(data + pos) != 0x02014b50) {
+            error = "bad central directory";
+            return false;
+        }
+        const char *record = data + pos;
+        uint16_t name_length = read16(record + 28);
+        uint16_t extra_length = read16(record + 30);
+        uint16_t comment_length = read16(record + 32);
+        if (pos + 46 + name_length + extra_length > size) {
+            error = "bad central directory";
+            return false;
+        }
+
+        Entry entry;
+        entry.name.assign(record + 46, name_length);
+        entry.method = read16(record + 10);
+        entry.crc = read32(record + 16);
+        entry.compressed_size = read32(record + 20);
+        entry.size = read32(record + 24);
+        entry.offset = read32(record + 42);
+        bool encrypted = read16(record + 8) & 1;
+
+        // Zip64 sizes and offset follow, in this order, for each field
+        // saturated in the record itself.
+        const char *extra = record + 46 + name_length;
+        const char *extra_end = extra + extra_length;
+        while (extra + 4 <= extra_end) {
+            uint16_t id = read16(extra), length = read16(extra + 2);
+            const char *field = extra + 4, *field_end = field + length;
+            if (field_end > extra_end)
+                break;
+            if (id == 0x0001) {
+                uint64_t *wide[] = {&entry.size, &entry.compressed_size,
+                                    &entry.offset};
+                for (uint64_t *value : wide) {
+                    if (*value == 0xffffffff && field + 8 <= field_end) {
+                        *value = read64(field);
+                        field += 8;
+                    }
+                }
+            }
+            extra = field_end;
+        }
+
+        pos += 46 + name_length + extra_length + comment_length;
+        if (encrypted || !has_xml_suffix(entry.name))
+            continue;
+        entries_.push_back(entry);
+    }
+    return true;
+}
+
+bool ZipReader::extract(size_t i, ArchiveBuffer &buffer,
+                        std::string &error) const {
+    const Entry &entry = entries_[i];
+    const char *data = file_.data();
+    size_t size = file_.size();
+
+    if (entry.offset + 30 > size ||
+        read32(data + entry.offset) != 0x04034b50) {
+        error = "bad local header for " + entry.name;
+        return false;
+    }
+    uint64_t start = entry.offset + 30 + read16(data + entry.offset + 26) +
+                     read16(data + entry.offset + 28);
+    if (start + entry.compressed_size > size) {
+        error = "truncated entry " + entry.name;
+        return false;
+    }
+    const char *in = data + start;
+
+    char *out = buffer.reserve(entry.size);
+    if (entry.method == 0) {
+        if (entry.compressed_size != entry.size) {
+            error = "bad stored entry " + entry.name;
+            return false;
+        }
+        memcpy(out, in, entry.size);
+    } else if (entry.method == 8) {
+        z_stream &stream = buffer.stream_;
+        if (!buffer.inflating_) {
+            memset(&stream, 0, sizeof(stream));
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+                error = "could not start inflate";
+                return false;
+            }
+            buffer.inflating_ = true;
+        } else {
+            inflateReset(&stream);
+        }
+
+        // Entries over 4 GiB would need chunked input; dumps never are.
+        stream.next_in = (Bytef *)in;
+        stream.avail_in = entry.compressed_size;
+        stream.next_out = (Bytef *)out;
+        stream.avail_out = entry.size;
+        int result = inflate(&stream, Z_FINISH);
+        if (result != Z_STREAM_END || stream.total_out != entry.size) {
+            error = "could not inflate " + entry.name;
+            return false;
+        }
+    } else {
+        error = "unsupported compression method for " + entry.name;
+        return false;
+    }
+
+    if (crc32(0, (const Bytef *)out, entry.size) != entry.crc) {
+        error = "checksum mismatch in " + entry.name;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_ARCHIVE_H
+#define UIDUMP_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "mapped_file.h"
+
+enum ArchiveKind {
+    ARCHIVE_NONE,
+    ARCHIVE_TAR, // .tar, .tar.gz or .tgz
+    ARCHIVE_ZIP,
+};
+
+// Tells archives from plain dumps by their file name.
+ArchiveKind archive_kind(const std::string &path);
+
+// Scratch space for reading entries: the output buffer and the inflate
+// state are reused from one entry to the next, so a worker allocates only
+// when it meets an entry bigger than any before. One per thread.
+class ArchiveBuffer {
+  public:
+    ArchiveBuffer() = default;
+    ArchiveBuffer(const ArchiveBuffer &) = delete;
+    ArchiveBuffer &operator=(const ArchiveBuffer &) = delete;
+    ~ArchiveBuffer();
+
+    const char *data() const { return data_.data(); }
+    size_t size() const { return size_; }
+
+  private:
+    friend class TarReader;
+    friend class ZipReader;
+
+    char *reserve(size_t size);
+
+    std::vector<char> data_;
+    size_t size_ = 0;
+    z_stream stream_;
+    bool inflating_ = false;
+};
+
+// Walks the entries of a tar archive in order. Compressed archives are
+// read through gzip, which passes plain tar files through unchanged.
+// Only regular files ending in .xml are returned.
+class TarReader {
+  public:
+    TarReader() = default;
+    TarReader(const TarReader &) = delete;
+    TarReader &operator=(const TarReader &) = delete;
+    ~TarReader();
+
+    bool open(const std::string &path, std::string &error);
+
+    // Reads the next dump into buffer. False at the end of the archive
+    // or on error, in which case error is set.
+    bool next(std::string &name, ArchiveBuffer &buffer, std::string &error);
+
+  private:
+    bool skip(uint64_t size);
+
+    gzFile file_ = nullptr;
+};
+
+// Reads a zip archive through its central directory. Entries are
+// compressed independently, so any number of threads may extract
+// different entries at once, each into its own buffer.
+class ZipReader {
+  public:
+    bool open(const std::string &path, std::string &error);
+
+    size_t size() const { return entries_.size(); }
+    const std::string &name(size_t i) const { return entries_[i].name; }
+
+    bool extract(size_t i, ArchiveBuffer &buffer, std::string &error) const;
+
+  private:
+    struct Entry {
+        std::string name;
+        uint16_t method;
+        uint32_t crc;
+        uint64_t compressed_size;
+        uint64_t size;
+        uint64_t offset; // of the local header
+    };
+
+    bool read_directory(std::string &error);
+
+    MappedFile file_;
+    std::vector<Entry> entries_;
+};
+
+#endif // UIDUMP_ARCHIVE_H
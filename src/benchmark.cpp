@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "benchmark.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "progress.h"
+
+namespace {
+
+// Two-sided 95% Student t quantiles for 1 to 30 degrees of freedom;
+// beyond that the normal quantile is close enough.
+const double T95[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                      2.306,  2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+                      2.131,  2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                      2.074,  2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+                      2.045,  2.042};
+
+double t95(unsigned degrees) {
+    if (degrees == 0)
+        return 0;
+    return degrees <= 30 ? T95[degrees - 1] : 1.960;
+}
+
+} // namespace
+
+BenchResult run_benchmark(const std::function<void(uint64_t)> &fn,
+                          unsigned samples, double sample_ms) {
+    const uint64_t target = static_cast<uint64_t>(sample_ms * 1e6);
+
+    // Grow the batch until one takes long enough to time, which also
+    // warms the caches and the allocator up.
+    uint64_t ops = 1;
+    for (;;) {
+        uint64_t start = now_ns();
+        fn(ops);
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed >= target)
+            break;
+        uint64_t scale = elapsed ? target / elapsed + 1 : 100;
+        ops *= scale < 2 ? 2 : scale > 100 ? 100 : scale;
+    }
+
+    std::vector<double> times(samples);
+    for (auto &t : times) {
+        uint64_t start = now_ns();
+        fn(ops);
+        t = static_cast<double>(now_ns() - start) / ops;
+    }
+
+    double mean = 0;
+    for (double t : times)
+        mean += t;
+    mean /= samples;
+    double variance = 0;
+    for (double t : times)
+        variance += (t - mean) * (t - mean);
+    variance /= samples > 1 ? samples - 1 : 1;
+
+    BenchResult result;
+    result.ns_per_op = mean;
+    result.ci95 = t95(samples - 1) * std::sqrt(variance / samples);
+    result.samples = samples;
+    result.ops_per_sample = ops;
+    return result;
+}
+
+void print_bench_result(std::ostream &out, const char *name,
+                        const BenchResult &result, size_t bytes_per_op) {
+    char line[160];
+    int n = snprintf(line, sizeof(line), "%-40s %12.2f ns/op +- %5.1f%%",
+                     name, result.ns_per_op,
+                     result.ns_per_op ? 100 * result.ci95 / result.ns_per_op
+                                      : 0.0);
+    if (bytes_per_op && n > 0 && n < static_cast<int>(sizeof(line)))
+        snprintf(line + n, sizeof(line) - n, "  %8.3f ns/byte  %8.1f MB/s",
+                 result.ns_per_op / bytes_per_op,
+                 bytes_per_op * 1e3 / result.ns_per_op);
+    out << line << "\n";
+}
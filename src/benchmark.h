@@ -0,0 +1,52 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_BENCHMARK_H
+#define UIDUMP_BENCHMARK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// Timing of one benchmark: the mean cost of an operation over a number
+// of samples, each a batch of operations long enough for the clock to
+// be accurate, and the half-width of its 95% confidence interval.
+struct BenchResult {
+    double ns_per_op;
+    double ci95;
+    unsigned samples;
+    uint64_t ops_per_sample;
+};
+
+// Runs fn(n), which must perform n operations, until it has samples
+// batches of about sample_ms each.
+BenchResult run_benchmark(const std::function<void(uint64_t)> &fn,
+                          unsigned samples = 20, double sample_ms = 5);
+
+// One aligned line: name, ns/op with its interval and, when the
+// operation has a size, ns/byte and MB/s.
+void print_bench_result(std::ostream &out, const char *name,
+                        const BenchResult &result, size_t bytes_per_op = 0);
+
+// Keeps the compiler from dropping a computation whose result is
+// otherwise unused.
+template <typename T> inline void do_not_optimize(const T &value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+#endif // UIDUMP_BENCHMARK_H
@@ -0,0 +1,404 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bloom_index.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "mapped_file.h"
+#include "parallel.h"
+
+using namespace tinyxml2;
+
+const char *const INDEX_FILE_NAME = ".uidump-index";
+
+static const char INDEX_MAGIC[8] = {'U', 'I', 'D', 'X', 'B', 'L', 'M', '1'};
+static const unsigned BITS_PER_KEY = 10;
+static const unsigned HASHES = 7; // ~1% false positives at 10 bits/key
+
+static const char *const INDEXED_ATTRIBUTES[] = {"resource-id", "class",
+                                                 "text", "content-desc"};
+
+static uint64_t hash_key(const std::string &attribute, bool word,
+                         const char *value, size_t length) {
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : attribute) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    h ^= word ? '~' : '=';
+    h *= 1099511628211ULL;
+    for (size_t i = 0; i < length; i++) {
+        h ^= (unsigned char)value[i];
+        h *= 1099511628211ULL;
+    }
+    // FNV leaves the high bits weak; finish with a 64-bit mixer because
+    // the filter derives its probe positions from both halves.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void collect_words(const std::string &attribute, const char *text,
+                          size_t length, bool inner_only,
+                          std::vector<uint64_t> &out) {
+    size_t i = 0;
+    while (i < length) {
+        while (i < length && is_space(text[i]))
+            i++;
+        size_t start = i;
+        while (i < length && !is_space(text[i]))
+            i++;
+        if (i == start)
+            break;
+        // In a substring the first and last words may be cut off.
+        if (inner_only && (start == 0 || i == length))
+            continue;
+        out.push_back(hash_key(attribute, true, text + start, i - start));
+    }
+}
+
+void collect_index_keys(const XMLElement *root, std::vector<uint64_t> &out) {
+    static const std::string text_attribute = "text";
+    for (const char *name : INDEXED_ATTRIBUTES) {
+        const char *value = root->Attribute(name);
+        if (!value || !*value)
+            continue;
+        size_t length = strlen(value);
+        out.push_back(hash_key(name, false, value, length));
+        if (name == text_attribute)
+            collect_words(text_attribute, value, length, false, out);
+    }
+    for (const XMLElement *child = root->FirstChildElement(); child != nullptr;
+         child = child->NextSiblingElement()) {
+        collect_index_keys(child, out);
+    }
+}
+
+void query_index_keys(const QueryTerm &term, std::vector<uint64_t> &out) {
+    bool indexed = false;
+    for (const char *name : INDEXED_ATTRIBUTES)
+        indexed |= term.attribute == name;
+    if (!indexed || term.value.empty())
+        return;
+    if (term.exact)
+        out.push_back(hash_key(term.attribute, false, term.value.data(),
+                               term.value.size()));
+    else if (term.attribute == "text")
+        collect_words(term.attribute, term.value.data(), term.value.size(),
+                      true, out);
+}
+
+void BloomFilter::build(const std::vector<uint64_t> &keys) {
+    bits = keys.size() * BITS_PER_KEY;
+    bits = bits < 64 ? 64 : (bits + 7) & ~7u;
+    hashes = HASHES;
+    words.assign(bits / 8, 0);
+    for (uint64_t key : keys) {
+        uint32_t h1 = key, h2 = key >> 32 | 1;
+        for (unsigned i = 0; i < hashes; i++) {
+            uint32_t bit = (h1 + i * h2) % bits;
+            words[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+bool BloomFilter::may_contain(uint64_t key) const {
+    if (bits == 0)
+        return true;
+    uint32_t h1 = key, h2 = key >> 32 | 1;
+    for (unsigned i = 0; i < hashes; i++) {
+        uint32_t bit = (h1 + i * h2) % bits;
+        if (!(words[bit / 8] & (1 << (bit % 8))))
+            return false;
+    }
+    return true;
+}
+
+// Shard layout: magic, entry count, then per entry
+//   u16 name length, name, i64 mtime, i64 size, u32 bits, u8 hashes,
+//   bits / 8 filter bytes.
+namespace {
+
+struct Reader {
+    const char *p, *end;
+
+    bool take(void *out, size_t n) {
+        if ((size_t)(end - p) < n)
+            return false;
+        memcpy(out, p, n);
+        p += n;
+        return true;
+    }
+
+    bool entry(std::string &name, IndexEntry &entry) {
+        uint16_t name_length;
+        if (!take(&name_length, sizeof(name_length)) ||
+            (size_t)(end - p) < name_length)
+            return false;
+        name.assign(p, name_length);
+        p += name_length;
+        if (!take(&entry.mtime, sizeof(entry.mtime)) ||
+            !take(&entry.size, sizeof(entry.size)) ||
+            !take(&entry.filter.bits, sizeof(entry.filter.bits)) ||
+            !take(&entry.filter.hashes, sizeof(entry.filter.hashes)) ||
+            entry.filter.bits % 8 != 0)
+            return false;
+        entry.filter.words.resize(entry.filter.bits / 8);
+        return take(entry.filter.words.data(), entry.filter.words.size());
+    }
+};
+
+} // namespace
+
+bool IndexShard::load(const std::string &dir) {
+    entries.clear();
+    MappedFile file;
+    if (!file.open((dir + "/" + INDEX_FILE_NAME).c_str()))
+        return false;
+    return parse(file.data(), file.size());
+}
+
+bool IndexShard::parse(const char *data, size_t size) {
+    entries.clear();
+    Reader in = {data, data + size};
+    char magic[8];
+    uint32_t count;
+    if (!in.take(magic, sizeof(magic)) ||
+        memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 ||
+        !in.take(&count, sizeof(count)))
+        return false;
+
+    std::string name;
+    for (uint32_t i = 0; i < count; i++) {
+        IndexEntry entry;
+        if (!in.entry(name, entry)) {
+            entries.clear();
+            return false;
+        }
+        entries[name] = entry;
+    }
+    return true;
+}
+
+static void append(std::string &out, const void *data, size_t size) {
+    out.append((const char *)data, size);
+}
+
+void IndexShard::serialize(std::string &out) const {
+    append(out, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    uint32_t count = entries.size();
+    append(out, &count, sizeof(count));
+    for (const auto &it : entries) {
+        const IndexEntry &entry = it.second;
+        uint16_t name_length = it.first.size();
+        append(out, &name_length, sizeof(name_length));
+        append(out, it.first.data(), name_length);
+        append(out, &entry.mtime, sizeof(entry.mtime));
+        append(out, &entry.size, sizeof(entry.size));
+        append(out, &entry.filter.bits, sizeof(entry.filter.bits));
+        append(out, &entry.filter.hashes, sizeof(entry.filter.hashes));
+        append(out, entry.filter.words.data(), entry.filter.words.size());
+    }
+}
+
+bool IndexShard::save(const std::string &dir) const {
+    std::string path = dir + "/" + INDEX_FILE_NAME;
+    std::string temp = path + ".tmp" + std::to_string(getpid());
+    FILE *out = fopen(temp.c_str(), "wb");
+    if (!out)
+        return false;
+
+    std::string data;
+    serialize(data);
+    bool ok = fwrite(data.data(), 1, data.size(), out) == data.size();
+    ok &= fclose(out) == 0;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void split_path(const std::string &path, std::string &dir,
+                       std::string &name) {
+    size_t slash = path.rfind('/');
+    dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool stat_file(const std::string &path, int64_t &mtime,
+                      int64_t &size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    size = st.st_size;
+    return true;
+}
+
+bool index_files(const std::vector<std::string> &files, unsigned jobs,
+                 IndexShards &out) {
+    struct Work {
+        std::string path;
+        IndexEntry *entry;
+    };
+
+    IndexShards on_disk;
+    std::vector<Work> stale;
+    for (const std::string &path : files) {
+        if (archive_kind(path) != ARCHIVE_NONE) {
+            std::cerr << "Warning: not indexing archive " << path << "\n";
+            continue;
+        }
+        std::string dir, name;
+        split_path(path, dir, name);
+        auto shard = on_disk.find(dir);
+        if (shard == on_disk.end()) {
+            shard = on_disk.insert(std::make_pair(dir, IndexShard())).first;
+            shard->second.load(dir);
+        }
+
+        int64_t mtime, size;
+        if (!stat_file(path, mtime, size))
+            continue;
+        IndexEntry &entry = out[dir].entries[name];
+        auto known = shard->second.entries.find(name);
+        if (known != shard->second.entries.end() &&
+            known->second.filter.bits && known->second.mtime == mtime &&
+            known->second.size == size) {
+            entry = known->second;
+            continue;
+        }
+        entry.mtime = mtime;
+        entry.size = size;
+        Work work = {path, &entry};
+        stale.push_back(work);
+    }
+
+    std::mutex error_lock;
+    bool ok = true;
+    parallel_for(stale.size(), jobs, [&](size_t i, unsigned) {
+        Work &work = stale[i];
+        XMLDocument doc;
+        std::vector<uint64_t> keys;
+        if (doc.LoadFile(work.path.c_str()) != XML_SUCCESS) {
+            std::lock_guard<std::mutex> lock(error_lock);
+            std::cerr << "Error: could not parse file " << work.path << "\n";
+            ok = false;
+            work.entry->filter = BloomFilter(); // queries will parse it
+            return;
+        }
+        collect_index_keys(doc.RootElement(), keys);
+        work.entry->filter.build(keys);
+    });
+    return ok;
+}
+
+bool update_index(const std::string &dir, const IndexShard &fresh) {
+    IndexShard shard;
+    shard.load(dir);
+    for (const auto &it : fresh.entries)
+        shard.entries[it.first] = it.second;
+
+    // Forget dumps that no longer exist.
+    for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+        int64_t mtime, size;
+        if (!stat_file(dir + "/" + it->first, mtime, size))
+            it = shard.entries.erase(it);
+        else
+            ++it;
+    }
+    if (!shard.save(dir)) {
+        std::cerr << "Error: could not write " << dir << "/"
+                  << INDEX_FILE_NAME << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool build_indexes(const std::vector<std::string> &files, unsigned jobs) {
+    IndexShards shards;
+    bool ok = index_files(files, jobs, shards);
+    for (const auto &shard : shards)
+        ok &= update_index(shard.first, shard.second);
+    return ok;
+}
+
+void IndexLookup::require(const std::vector<uint64_t> &keys) {
+    if (keys_.empty())
+        keys_.emplace_back();
+    keys_.back().insert(keys_.back().end(), keys.begin(), keys.end());
+}
+
+void IndexLookup::alternative() {
+    if (!keys_.empty())
+        keys_.emplace_back();
+}
+
+bool IndexLookup::may_match(const std::string &path) {
+    if (keys_.empty())
+        return true;
+
+    std::string dir, name;
+    split_path(path, dir, name);
+    const IndexShard *shard;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        auto found = shards_.find(dir);
+        if (found == shards_.end()) {
+            found = shards_.insert(std::make_pair(dir, IndexShard())).first;
+            found->second.load(dir);
+        }
+        shard = &found->second; // loaded once, then only read
+    }
+
+    auto it = shard->entries.find(name);
+    if (it == shard->entries.end())
+        return true;
+    int64_t mtime, size;
+    if (!stat_file(path, mtime, size) || it->second.mtime != mtime ||
+        it->second.size != size) {
+        stale_++; // the filter may not describe the file
+        return true;
+    }
+
+    for (const std::vector<uint64_t> &keys : keys_) {
+        bool all = true;
+        for (uint64_t key : keys) {
+            if (!it->second.filter.may_contain(key)) {
+                all = false;
+                break;
+            }
+        }
+        if (all)
+            return true;
+    }
+    return false;
+}
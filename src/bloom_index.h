@@ -0,0 +1,120 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_BLOOM_INDEX_H
+#define UIDUMP_BLOOM_INDEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "query.h"
+#include "tinyxml2/tinyxml2.h"
+
+// Sidecar Bloom filters for repeated scans of the same archive.
+//
+// Each directory of dumps gets one shard file, INDEX_FILE_NAME, holding
+// a Bloom filter per dump over the resource-id, class, text and
+// content-desc values present in it, plus the individual words of every
+// text. Entries remember the dump's mtime and size; one whose dump has
+// changed is ignored by queries, which count it so the run can suggest
+// an indexing pass to rebuild it. Archives are not indexed.
+
+extern const char *const INDEX_FILE_NAME;
+
+// Hashes of the index keys a dump contributes, duplicates included.
+void collect_index_keys(const tinyxml2::XMLElement *root,
+                        std::vector<uint64_t> &out);
+
+// Key hashes a matching dump must contain for each term; terms the index
+// cannot answer contribute none.
+void query_index_keys(const QueryTerm &term, std::vector<uint64_t> &out);
+
+struct BloomFilter {
+    uint32_t bits = 0;
+    uint8_t hashes = 0;
+    std::vector<uint8_t> words;
+
+    void build(const std::vector<uint64_t> &keys);
+    bool may_contain(uint64_t key) const;
+};
+
+struct IndexEntry {
+    int64_t mtime;
+    int64_t size;
+    BloomFilter filter;
+};
+
+class IndexShard {
+  public:
+    // A missing or unreadable shard loads as empty.
+    bool load(const std::string &dir);
+    bool save(const std::string &dir) const;
+
+    // The on-disk layout, for shards that travel inside other files.
+    bool parse(const char *data, size_t size);
+    void serialize(std::string &out) const;
+
+    std::unordered_map<std::string, IndexEntry> entries;
+};
+
+// Shards by directory.
+typedef std::map<std::string, IndexShard> IndexShards;
+
+// Fills out with an up-to-date entry for each of files, reusing fresh
+// entries from the shards on disk and re-reading only dumps that are new
+// or whose mtime or size changed. Archives are skipped with a warning.
+// Nothing is written.
+bool index_files(const std::vector<std::string> &files, unsigned jobs,
+                 IndexShards &out);
+
+// Writes fresh entries into the shard of dir, forgetting dumps that no
+// longer exist.
+bool update_index(const std::string &dir, const IndexShard &fresh);
+
+// index_files followed by update_index for every directory involved.
+bool build_indexes(const std::vector<std::string> &files, unsigned jobs);
+
+// Query-side view of the shards, loaded lazily per directory.
+class IndexLookup {
+  public:
+    void require(const std::vector<uint64_t> &keys);
+    // Later keys form another set; a file then only has to hold every
+    // key of one of the sets.
+    void alternative();
+
+    // False only when a fresh filter for path proves a key missing. Safe
+    // to call from several threads.
+    bool may_match(const std::string &path);
+
+    bool empty() const { return keys_.empty(); }
+
+    // Indexed files seen so far whose entry no longer matches the file.
+    size_t stale() const { return stale_; }
+
+  private:
+    std::vector<std::vector<uint64_t>> keys_;
+    std::atomic<size_t> stale_{0};
+    std::mutex lock_; // guards shards_
+    std::unordered_map<std::string, IndexShard> shards_;
+};
+
+#endif // UIDUMP_BLOOM_INDEX_H
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bounds.h"
+
+#include <algorithm>
+
+using namespace tinyxml2;
+
+static bool parse_int(const char *&p, int &out) {
+    bool negative = false;
+    if (*p == '-') {
+        negative = true;
+        ++p;
+    }
+    if (*p < '0' || *p > '9')
+        return false;
+    int value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+static bool expect(const char *&p, char c) {
+    if (*p != c)
+        return false;
+    ++p;
+    return true;
+}
+
+bool parse_bounds(const char *value, Bounds &out) {
+    if (!value)
+        return false;
+    const char *p = value;
+    return expect(p, '[') && parse_int(p, out.left) && expect(p, ',') &&
+           parse_int(p, out.top) && expect(p, ']') && expect(p, '[') &&
+           parse_int(p, out.right) && expect(p, ',') &&
+           parse_int(p, out.bottom) && expect(p, ']');
+}
+
+bool element_bounds(const XMLElement *element, Bounds &out) {
+    return parse_bounds(element->Attribute("bounds"), out);
+}
+
+long long bounds_gap_squared(const Bounds &a, const Bounds &b) {
+    long long dx = 0, dy = 0;
+    if (b.left > a.right)
+        dx = b.left - a.right;
+    else if (a.left > b.right)
+        dx = a.left - b.right;
+    if (b.top > a.bottom)
+        dy = b.top - a.bottom;
+    else if (a.top > b.bottom)
+        dy = a.top - b.bottom;
+    return dx * dx + dy * dy;
+}
+
+bool intervals_aligned(int a_lo, int a_hi, int b_lo, int b_hi) {
+    int overlap = std::min(a_hi, b_hi) - std::max(a_lo, b_lo);
+    int shorter = std::min(a_hi - a_lo, b_hi - b_lo);
+    return overlap > 0 && overlap * 2 >= shorter;
+}
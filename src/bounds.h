@@ -0,0 +1,48 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_BOUNDS_H
+#define UIDUMP_BOUNDS_H
+
+#include "tinyxml2/tinyxml2.h"
+
+// Screen rectangle as written by uiautomator: "[left,top][right,bottom]".
+struct Bounds {
+    int left, top, right, bottom;
+
+    int width() const { return right - left; }
+    int height() const { return bottom - top; }
+    int center_x() const { return left + (right - left) / 2; }
+    int center_y() const { return top + (bottom - top) / 2; }
+    long long area() const {
+        return (long long)(right > left ? right - left : 0) *
+               (bottom > top ? bottom - top : 0);
+    }
+};
+
+bool parse_bounds(const char *value, Bounds &out);
+bool element_bounds(const tinyxml2::XMLElement *element, Bounds &out);
+
+// Squared length of the gap between two rectangles, 0 if they touch or
+// overlap.
+long long bounds_gap_squared(const Bounds &a, const Bounds &b);
+
+// Whether [a_lo, a_hi) and [b_lo, b_hi) overlap by at least half of the
+// shorter one; used to decide that two nodes share a row or column.
+bool intervals_aligned(int a_lo, int a_hi, int b_lo, int b_hi);
+
+#endif // UIDUMP_BOUNDS_H
@@ -0,0 +1,212 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+static uint64_t fingerprint_inputs(const ShardSpec &shard,
+                                   const std::vector<std::string> &inputs) {
+    uint64_t hash = 1469598103934665603ULL ^ shard.index ^
+                    (uint64_t)shard.count << 32;
+    for (const std::string &input : inputs) {
+        for (char c : input)
+            hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+        hash = (hash ^ '\n') * 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool Checkpoint::open(const std::string &path, const ShardSpec &shard,
+                      const std::vector<std::string> &inputs, bool resume,
+                      std::string &error) {
+    fingerprint_ = fingerprint_inputs(shard, inputs);
+
+    off_t valid = 0;
+    bool resuming = resume && access(path.c_str(), F_OK) == 0;
+    if (resuming) {
+        MappedFile file;
+        if (!file.open(path.c_str())) {
+            error = "could not read " + path;
+            return false;
+        }
+
+        PartialReader in(file.data(), file.size());
+        ShardSpec spec;
+        if (!in.header(spec) || spec.index != shard.index ||
+            spec.count != shard.count) {
+            error = path + " is not a checkpoint of this run";
+            return false;
+        }
+        valid = in.offset();
+
+        std::string kind;
+        const char *section;
+        size_t length;
+        bool identified = false;
+        while (in.next(kind, section, length)) {
+            if (kind == "inputs") {
+                uint64_t fingerprint;
+                if (!(std::istringstream(std::string(section, length)) >>
+                      fingerprint))
+                    break;
+                if (fingerprint != fingerprint_) {
+                    error = path + " is a checkpoint of other inputs";
+                    return false;
+                }
+                identified = true;
+                valid = in.offset();
+                continue;
+            }
+            if (kind != "checkpoint")
+                continue;
+            std::istringstream text(std::string(section, length));
+            size_t completed;
+            uint64_t fingerprint;
+            LintSummary lint;
+            if (!(text >> completed >> fingerprint) || !lint.read(text))
+                break; // torn write; the previous checkpoint stands
+            if (fingerprint != fingerprint_) {
+                error = path + " is a checkpoint of other inputs";
+                return false;
+            }
+            identified = true;
+            completed_ = completed;
+            lint_ = lint;
+            valid = in.offset();
+        }
+        if (in.ended()) {
+            if (!identified) {
+                error = path + " does not record the inputs of its run";
+                return false;
+            }
+            complete_ = true;
+            valid = file.size();
+        } else if (!identified) {
+            resuming = false; // cut off before any progress; start afresh
+        }
+    }
+
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | (resuming ? 0 : O_TRUNC),
+                 0644);
+    if (fd_ < 0 || (resuming && (ftruncate(fd_, valid) != 0 ||
+                                 lseek(fd_, 0, SEEK_END) < 0))) {
+        error = "could not write " + path;
+        return false;
+    }
+
+    last_save_ = std::chrono::steady_clock::now();
+    writer_ = std::thread(&Checkpoint::write_loop, this);
+    if (!resuming) {
+        partial_.begin(shard);
+        partial_.add_section("inputs", std::to_string(fingerprint_) + "\n");
+        queue();
+    }
+    return true;
+}
+
+bool Checkpoint::due() const {
+    return std::chrono::steady_clock::now() - last_save_ >=
+           std::chrono::seconds(CHECKPOINT_INTERVAL);
+}
+
+void Checkpoint::save(size_t completed, LintSummary lint) {
+    partial_.output().flush();
+    Pending pending = {pending_.str(), true, completed, std::move(lint)};
+    pending_.str(std::string());
+    queue(std::move(pending));
+    last_save_ = std::chrono::steady_clock::now();
+}
+
+void Checkpoint::queue() {
+    Pending pending = {pending_.str(), false, 0, LintSummary()};
+    pending_.str(std::string());
+    queue(std::move(pending));
+}
+
+void Checkpoint::queue(Pending pending) {
+    std::lock_guard<std::mutex> guard(lock_);
+    queue_.push_back(std::move(pending));
+    wake_.notify_one();
+}
+
+bool Checkpoint::finish(const LintSummary *lint) {
+    if (lint)
+        partial_.add_lint(*lint);
+    partial_.finish();
+    queue();
+    close();
+    return !failed_;
+}
+
+void Checkpoint::close() {
+    if (writer_.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+            closing_ = true;
+        }
+        wake_.notify_one();
+        writer_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+static bool write_all(int fd, const std::string &data) {
+    const char *p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t written = write(fd, p, left);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        p += written;
+        left -= written;
+    }
+    return true;
+}
+
+void Checkpoint::write_loop() {
+    std::unique_lock<std::mutex> guard(lock_);
+    for (;;) {
+        wake_.wait(guard, [this] { return closing_ || !queue_.empty(); });
+        if (queue_.empty())
+            return; // closing, and everything is written
+        Pending pending = std::move(queue_.front());
+        queue_.pop_front();
+
+        guard.unlock();
+        if (pending.checkpoint) {
+            std::ostringstream record;
+            record << pending.completed << " " << fingerprint_ << "\n";
+            pending.lint.write(record);
+            PartialWriter::frame_section(pending.data, "checkpoint",
+                                         record.str());
+        }
+        bool ok = write_all(fd_, pending.data) && fdatasync(fd_) == 0;
+        guard.lock();
+        if (!ok)
+            failed_ = true;
+    }
+}
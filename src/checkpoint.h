@@ -0,0 +1,118 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_CHECKPOINT_H
+#define UIDUMP_CHECKPOINT_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lint.h"
+#include "partial.h"
+
+// Seconds between checkpoints of a long run.
+const int CHECKPOINT_INTERVAL = 10;
+
+// Durable progress of a batch run, kept as a partial output (see
+// partial.h) that grows as the run goes. It opens with an "inputs"
+// section holding a fingerprint of the inputs. Every so often the output
+// produced since the last checkpoint is appended together with a
+// "checkpoint" section naming how many inputs are done and holding the
+// aggregates so far. A background thread formats the checkpoint, appends
+// and fsyncs, so neither the workers nor the thread writing their output
+// out wait on it.
+//
+// Resuming checks the fingerprint, even when the run had finished, then
+// reads the file back, drops whatever follows the last checkpoint and
+// carries on from there.
+class Checkpoint {
+  public:
+    Checkpoint() = default;
+    Checkpoint(const Checkpoint &) = delete;
+    Checkpoint &operator=(const Checkpoint &) = delete;
+    ~Checkpoint() { close(); }
+
+    // inputs identifies the work; a checkpoint of other inputs is refused.
+    // Without resume, or when path does not exist yet, starts afresh.
+    bool open(const std::string &path, const ShardSpec &shard,
+              const std::vector<std::string> &inputs, bool resume,
+              std::string &error);
+
+    // Inputs finished according to the checkpoint resumed from, and the
+    // aggregates at that point.
+    size_t completed() const { return completed_; }
+    const LintSummary &lint() const { return lint_; }
+
+    // Whether the run finished before; its output just needs printing.
+    bool complete() const { return complete_; }
+
+    // Where the run writes its results.
+    PartialWriter &partial() { return partial_; }
+
+    bool due() const;
+
+    // Queues the output so far and a checkpoint saying the first
+    // completed inputs are done, with lint their totals.
+    void save(size_t completed, LintSummary lint);
+
+    // Queues the final lint totals, if any, and the end marker, then
+    // waits for the writer. False when any write failed.
+    bool finish(const LintSummary *lint);
+
+    void close();
+
+  private:
+    bool resume_from(const std::string &path, const ShardSpec &shard,
+                     std::string &error);
+    // Output to append, then the checkpoint it completes, if any.
+    struct Pending {
+        std::string data;
+        bool checkpoint;
+        size_t completed;
+        LintSummary lint;
+    };
+
+    void queue();
+    void queue(Pending pending);
+    void write_loop();
+
+    uint64_t fingerprint_ = 0;
+    size_t completed_ = 0;
+    bool complete_ = false;
+    LintSummary lint_;
+
+    std::ostringstream pending_;
+    PartialWriter partial_{pending_};
+    std::chrono::steady_clock::time_point last_save_;
+
+    int fd_ = -1;
+    std::thread writer_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    std::deque<Pending> queue_;
+    bool closing_ = false;
+    bool failed_ = false;
+};
+
+#endif // UIDUMP_CHECKPOINT_H
@@ -0,0 +1,534 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "difftest.h"
+
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "query.h"
+
+static const unsigned DIFF_QUERIES_PER_CASE = 8;
+
+namespace {
+
+struct GenAttribute {
+    std::string name;
+    std::string value; // as a query would name it
+    std::string raw;   // as written in the dump, quotes included
+    std::string space; // before the name
+    std::string equals; // "=", or with whitespace around it
+};
+
+struct GenNode {
+    std::string name;
+    std::vector<GenAttribute> attributes;
+    std::vector<GenNode> children;
+    std::string before; // whitespace or a comment before the tag
+    bool explicit_close; // <node></node> rather than <node />
+};
+
+struct GenDump {
+    bool declaration;
+    GenNode root;
+    size_t truncate; // bytes to cut off the end, 0 for none
+};
+
+class Random {
+  public:
+    explicit Random(unsigned seed) : rng_(seed) {}
+
+    // Uniform in [0, n); mt19937 output is the same everywhere, unlike
+    // the standard distributions.
+    unsigned below(unsigned n) { return n ? rng_() % n : 0; }
+    bool chance(unsigned percent) { return below(100) < percent; }
+
+    template <typename T, size_t N> const T &pick(const T (&items)[N]) {
+        return items[below(N)];
+    }
+
+  private:
+    std::mt19937 rng_;
+};
+
+const char *const ATTRIBUTE_NAMES[] = {
+    "index",     "text",      "resource-id", "class",     "package",
+    "content-desc", "checkable", "checked",   "clickable", "enabled",
+    "focusable", "focused",   "scrollable",  "long-clickable",
+    "password",  "selected",  "bounds",
+};
+
+const char *const WORDS[] = {
+    "OK",      "Sign in", "Item 3",  "a & b",  "<b>",       "\"quoted\"",
+    "it's",    "caf\xc3\xa9", "\xe6\x97\xa5\xe6\x9c\xac", "  padded  ",
+    "x=1",     "50%",     "line\nbreak", "tab\there", "",
+};
+
+const char *const CLASSES[] = {
+    "android.widget.TextView",  "android.widget.Button",
+    "android.widget.ImageView", "android.widget.FrameLayout",
+    "android.view.View",        "android.webkit.WebView",
+};
+
+std::string random_value(Random &rng, const std::string &name,
+                         unsigned index) {
+    if (name == "index")
+        return std::to_string(index);
+    if (name == "class")
+        return rng.pick(CLASSES);
+    if (name == "package")
+        return rng.chance(80) ? "com.example.app" : "com.android.systemui";
+    if (name == "resource-id")
+        return rng.chance(30) ? ""
+                              : "com.example.app:id/v" +
+                                    std::to_string(rng.below(12));
+    if (name == "bounds") {
+        unsigned x = rng.below(1000), y = rng.below(2000);
+        return "[" + std::to_string(x) + "," + std::to_string(y) + "][" +
+               std::to_string(x + rng.below(300)) + "," +
+               std::to_string(y + rng.below(300)) + "]";
+    }
+    if (name == "text" || name == "content-desc") {
+        std::string text = rng.pick(WORDS);
+        if (rng.chance(20))
+            text += std::string(" ") + rng.pick(WORDS);
+        if (rng.chance(3))
+            text = std::string(200 + rng.below(2000), 'x') + text;
+        return text;
+    }
+    return rng.chance(50) ? "true" : "false";
+}
+
+// Writes value the way some XML writer might: the characters that must
+// be escaped always are, the rest now and then as character references.
+std::string encode(Random &rng, const std::string &value, char quote) {
+    std::string out(1, quote);
+    for (char c : value) {
+        if (c == '&') {
+            out += rng.chance(80) ? "&amp;" : "&#38;";
+        } else if (c == '<') {
+            out += rng.chance(80) ? "&lt;" : "&#x3C;";
+        } else if (c == quote) {
+            out += quote == '"' ? "&quot;" : "&apos;";
+        } else if (c == '>' && rng.chance(50)) {
+            out += "&gt;";
+        } else if (c == '\n' && rng.chance(50)) {
+            out += "&#10;";
+        } else if ((unsigned char)c < 0x80 && c != '\n' && rng.chance(3)) {
+            char ref[16];
+            snprintf(ref, sizeof(ref),
+                     rng.chance(50) ? "&#%d;" : "&#x%x;", c);
+            out += ref;
+        } else {
+            out += c;
+        }
+    }
+    out += quote;
+    return out;
+}
+
+// With uiautomator set, nodes are written the way uiautomator writes
+// them: every attribute in its order, double quotes, single spaces and
+// no comments, so the parsers that expect that are checked too.
+GenAttribute random_attribute(Random &rng, const std::string &name,
+                              unsigned index, bool uiautomator) {
+    GenAttribute a;
+    a.name = name;
+    a.value = random_value(rng, name, index);
+    a.raw = encode(rng, a.value,
+                   uiautomator || rng.chance(90) ? '"' : '\'');
+    if (uiautomator) {
+        a.space = " ";
+        a.equals = "=";
+        return a;
+    }
+    a.space = rng.chance(90) ? " " : rng.chance(50) ? "\n    " : " \t ";
+    a.equals = rng.chance(95) ? "=" : " = ";
+    return a;
+}
+
+std::string random_gap(Random &rng, bool uiautomator) {
+    if (uiautomator)
+        return "\n";
+    switch (rng.below(10)) {
+    case 0:
+        return "";
+    case 1:
+        return "\r\n\t";
+    case 2:
+        return "<!-- gap -->";
+    default:
+        return "\n";
+    }
+}
+
+// Mostly shallow trees, with the odd chain of single children dozens of
+// levels deep. budget bounds the number of nodes.
+GenNode random_node(Random &rng, unsigned index, unsigned depth,
+                    unsigned chain, unsigned &budget, bool uiautomator) {
+    GenNode node;
+    node.name = uiautomator || rng.chance(97) ? "node" : "View";
+    node.before = random_gap(rng, uiautomator);
+    node.explicit_close = rng.chance(10);
+
+    std::vector<std::string> names(std::begin(ATTRIBUTE_NAMES),
+                                   std::end(ATTRIBUTE_NAMES));
+    if (!uiautomator && rng.chance(10)) {
+        for (size_t i = names.size(); i > 1; i--)
+            std::swap(names[i - 1], names[rng.below(i)]);
+    }
+    for (const std::string &name : names) {
+        if (!uiautomator && rng.chance(3))
+            continue;
+        node.attributes.push_back(
+            random_attribute(rng, name, index, uiautomator));
+    }
+    if (!uiautomator && rng.chance(5))
+        node.attributes.push_back(
+            random_attribute(rng, "hint", index, uiautomator));
+
+    if (chain) {
+        node.children.push_back(random_node(rng, 0, depth + 1, chain - 1,
+                                            budget, uiautomator));
+        return node;
+    }
+    if (depth < 3 && rng.chance(2)) {
+        node.children.push_back(random_node(rng, 0, depth + 1,
+                                            30 + rng.below(50), budget,
+                                            uiautomator));
+        return node;
+    }
+    unsigned children = depth < 8 ? rng.below(5) : 0;
+    for (unsigned i = 0; i < children && budget; i++) {
+        budget--;
+        node.children.push_back(
+            random_node(rng, i, depth + 1, 0, budget, uiautomator));
+    }
+    return node;
+}
+
+GenDump random_dump(Random &rng) {
+    GenDump dump;
+    dump.declaration = rng.chance(90);
+    dump.root.name = "hierarchy";
+    dump.root.explicit_close = true;
+    GenAttribute rotation;
+    rotation.name = "rotation";
+    rotation.value = "0";
+    rotation.raw = "\"0\"";
+    rotation.space = " ";
+    rotation.equals = "=";
+    dump.root.attributes.push_back(rotation);
+
+    unsigned budget = 20 + rng.below(200);
+    unsigned children = 1 + rng.below(3);
+    bool uiautomator = rng.chance(25);
+    for (unsigned i = 0; i < children && budget; i++) {
+        budget--;
+        dump.root.children.push_back(
+            random_node(rng, i, 1, 0, budget, uiautomator));
+    }
+    dump.truncate = rng.chance(3) ? 1 + rng.below(200) : 0;
+    return dump;
+}
+
+void write_node(const GenNode &node, std::string &out) {
+    out += node.before;
+    out += '<';
+    out += node.name;
+    for (const GenAttribute &a : node.attributes) {
+        out += a.space;
+        out += a.name;
+        out += a.equals;
+        out += a.raw;
+    }
+    if (node.children.empty() && !node.explicit_close) {
+        out += " />";
+        return;
+    }
+    out += '>';
+    for (const GenNode &child : node.children)
+        write_node(child, out);
+    out += "</";
+    out += node.name;
+    out += '>';
+}
+
+std::string write_dump(const GenDump &dump) {
+    std::string out;
+    if (dump.declaration)
+        out += "<?xml version='1.0' encoding='UTF-8' standalone='yes' ?>";
+    write_node(dump.root, out);
+    out += '\n';
+    if (dump.truncate)
+        out.resize(out.size() > dump.truncate ? out.size() - dump.truncate
+                                              : 0);
+    return out;
+}
+
+void collect_attributes(const GenNode &node,
+                        std::vector<const GenAttribute *> &out) {
+    for (const GenAttribute &a : node.attributes)
+        out.push_back(&a);
+    for (const GenNode &child : node.children)
+        collect_attributes(child, out);
+}
+
+std::string quote(const std::string &value) {
+    char q = value.find('"') == std::string::npos ? '"' : '\'';
+    std::string text = value.substr(0, value.find(q));
+    return q + text + q;
+}
+
+std::string random_predicate(Random &rng,
+                             const std::vector<const GenAttribute *> &pool) {
+    const GenAttribute &a = *pool[rng.below(pool.size())];
+    std::string name = rng.chance(5) ? "missing" : a.name;
+    const std::string &v = a.value;
+    switch (rng.below(6)) {
+    case 0:
+        return name + "=" + quote(v);
+    case 1:
+        return name + "!=" + quote(v);
+    case 2: {
+        size_t start = rng.below(v.size() + 1);
+        return name + "~" + quote(v.substr(start, rng.below(6)));
+    }
+    case 3:
+        return name + "^=" + quote(v.substr(0, rng.below(v.size() + 1)));
+    case 4:
+        return name;
+    default:
+        return "!" + name + "=" + quote(v);
+    }
+}
+
+std::string random_query(Random &rng,
+                         const std::vector<const GenAttribute *> &pool,
+                         unsigned depth = 0) {
+    if (depth >= 2 || rng.chance(40))
+        return random_predicate(rng, pool);
+    std::string left = random_query(rng, pool, depth + 1);
+    std::string right = random_query(rng, pool, depth + 1);
+    switch (rng.below(3)) {
+    case 0:
+        return left + " && " + right;
+    case 1:
+        return "(" + left + ") || " + right;
+    default:
+        return "!(" + left + " || " + right + ")";
+    }
+}
+
+// What one engine made of one query on one dump.
+struct Outcome {
+    bool loaded;
+    std::vector<uint32_t> matches;
+    std::string output;
+};
+
+Outcome run_engine(const EngineInfo &info, const std::string &xml,
+                   const Query &query) {
+    std::unique_ptr<Engine> engine = info.create();
+    engine->set_queries(std::vector<Query>(1, query));
+    Outcome outcome;
+    std::string error;
+    outcome.loaded = engine->load(xml.data(), xml.size(), error);
+    if (!outcome.loaded)
+        return outcome;
+    engine->run(0, outcome.matches);
+    std::ostringstream out;
+    for (uint32_t element : outcome.matches)
+        engine->print(element, out);
+    outcome.output = out.str();
+    return outcome;
+}
+
+// An engine may skip a dump the reference rejects, as the prefilter
+// does, but must not find anything in it.
+bool agrees(const Outcome &reference, const Outcome &outcome) {
+    if (!reference.loaded)
+        return !outcome.loaded || outcome.matches.empty();
+    return outcome.loaded && outcome.matches == reference.matches &&
+           outcome.output == reference.output;
+}
+
+bool fails(const GenDump &dump, const Query &query,
+           const EngineInfo &engine) {
+    std::string xml = write_dump(dump);
+    return !agrees(run_engine(engines()[0], xml, query),
+                   run_engine(engine, xml, query));
+}
+
+// Greedily drops truncation, subtrees, wrapper nodes and attributes, and
+// shortens values, for as long as the engine still disagrees.
+class Minimizer {
+  public:
+    Minimizer(GenDump &dump, const Query &query, const EngineInfo &engine)
+        : dump_(dump), query_(query), engine_(engine) {}
+
+    void run() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            if (dump_.truncate) {
+                size_t truncate = dump_.truncate;
+                dump_.truncate = 0;
+                if (!still_fails())
+                    dump_.truncate = truncate;
+                else
+                    changed = true;
+            }
+            changed |= shrink(dump_.root);
+        }
+    }
+
+  private:
+    bool still_fails() { return fails(dump_, query_, engine_); }
+
+    bool shrink(GenNode &node) {
+        bool changed = false;
+        for (size_t i = 0; i < node.children.size();) {
+            GenNode removed = node.children[i];
+            node.children.erase(node.children.begin() + i);
+            if (still_fails()) {
+                changed = true;
+                continue;
+            }
+            node.children.insert(node.children.begin() + i, removed);
+
+            // Replace the node by its children, which unwinds deep
+            // nesting one level at a time.
+            std::vector<GenNode> lifted = removed.children;
+            if (!lifted.empty()) {
+                node.children.erase(node.children.begin() + i);
+                node.children.insert(node.children.begin() + i,
+                                     lifted.begin(), lifted.end());
+                if (still_fails()) {
+                    changed = true;
+                    continue;
+                }
+                node.children.erase(node.children.begin() + i,
+                                    node.children.begin() + i +
+                                        lifted.size());
+                node.children.insert(node.children.begin() + i, removed);
+            }
+            i++;
+        }
+
+        for (size_t i = 0; i < node.attributes.size();) {
+            GenAttribute removed = node.attributes[i];
+            node.attributes.erase(node.attributes.begin() + i);
+            if (still_fails()) {
+                changed = true;
+                continue;
+            }
+            node.attributes.insert(node.attributes.begin() + i, removed);
+            i++;
+        }
+
+        for (GenAttribute &a : node.attributes) {
+            while (a.raw.size() > 2) {
+                std::string raw = a.raw;
+                a.raw = raw.substr(0, (raw.size() - 2) / 2 + 1) + raw.back();
+                if (!still_fails()) {
+                    a.raw = raw;
+                    break;
+                }
+                changed = true;
+            }
+        }
+
+        for (GenNode &child : node.children)
+            changed |= shrink(child);
+        return changed;
+    }
+
+    GenDump &dump_;
+    const Query &query_;
+    const EngineInfo &engine_;
+};
+
+void print_outcome(std::ostream &out, const char *name,
+                   const Outcome &outcome) {
+    out << "  " << name << ": ";
+    if (!outcome.loaded) {
+        out << "rejected the dump\n";
+        return;
+    }
+    out << outcome.matches.size() << " match(es) [";
+    for (size_t i = 0; i < outcome.matches.size(); i++)
+        out << (i ? ", " : "") << outcome.matches[i];
+    out << "]\n";
+}
+
+} // namespace
+
+int differential_test(unsigned cases, std::ostream &out) {
+    const std::vector<EngineInfo> &all = engines();
+    size_t runs = 0, malformed = 0;
+
+    for (unsigned seed = 0; seed < cases; seed++) {
+        Random rng(seed);
+        GenDump dump = random_dump(rng);
+        std::string xml = write_dump(dump);
+        std::vector<const GenAttribute *> pool;
+        collect_attributes(dump.root, pool);
+
+        for (unsigned q = 0; q < DIFF_QUERIES_PER_CASE; q++) {
+            std::string text = random_query(rng, pool), error;
+            Query query;
+            if (!query.compile(text, error))
+                continue;
+
+            Outcome reference = run_engine(all[0], xml, query);
+            malformed += !reference.loaded && q == 0;
+            for (size_t e = 1; e < all.size(); e++) {
+                runs++;
+                if (agrees(reference, run_engine(all[e], xml, query)))
+                    continue;
+
+                Minimizer(dump, query, all[e]).run();
+                std::string minimal = write_dump(dump);
+                Outcome ref = run_engine(all[0], minimal, query);
+                Outcome got = run_engine(all[e], minimal, query);
+                out << "Differential test failed: case " << seed
+                    << ", engine " << all[e].name << ", query: " << text
+                    << "\n";
+                print_outcome(out, all[0].name, ref);
+                print_outcome(out, all[e].name, got);
+                if (ref.loaded && got.loaded && ref.matches == got.matches) {
+                    out << "Reference output:\n" << ref.output;
+                    out << all[e].name << " output:\n" << got.output;
+                }
+                out << "Minimized dump (" << minimal.size() << " bytes):\n"
+                    << minimal;
+                return 1;
+            }
+        }
+    }
+
+    out << "Differential test: " << cases << " case(s), " << malformed
+        << " malformed, " << runs << " query run(s): every engine agrees "
+        << "with " << all[0].name << "\n";
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_DIFFTEST_H
+#define UIDUMP_DIFFTEST_H
+
+#include <ostream>
+
+// Checks every engine against the DOM reference on cases randomized and
+// mutated dumps: entities, odd whitespace and quoting, shuffled or
+// missing attributes, comments, deep nesting and some truncated files.
+// Each dump gets random queries built from its own attribute values,
+// and the engines must return the same matches and print them the same
+// way. The first disagreement is shrunk to a minimal dump and printed.
+// Case i is generated from seed i, so a run is reproducible. Returns
+// the process exit status.
+int differential_test(unsigned cases, std::ostream &out);
+
+#endif // UIDUMP_DIFFTEST_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "engine.h"
+
+#include "prefilter.h"
+#include "schema.h"
+#include "search.h"
+#include "tape.h"
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+namespace {
+
+void collect_ordinals(const XMLElement *element, const QueryProgram &query,
+                      const QueryInterning *interning, uint32_t &ordinal,
+                      std::vector<uint32_t> &matches) {
+    for (; element; element = element->NextSiblingElement()) {
+        if (query_matches(query, element, interning))
+            matches.push_back(ordinal);
+        ordinal++;
+        collect_ordinals(element->FirstChildElement(), query, interning,
+                         ordinal, matches);
+    }
+}
+
+// Parses every dump with tinyxml2 and walks the tree per query. With
+// lazy attributes, only the attributes the queries look at are parsed.
+// With interning, the document interns the values of attributes with
+// few distinct values and equality on them compares pointers.
+class DomEngine : public Engine {
+  public:
+    explicit DomEngine(bool lazy = false, bool intern = false) {
+        doc_.SetLazyAttributes(lazy);
+        if (intern)
+            doc_.SetInternedAttributes(LOW_CARDINALITY_ATTRIBUTES);
+    }
+
+    void set_queries(const std::vector<Query> &queries) override {
+        queries_ = queries;
+    }
+
+    bool load(const char *xml, size_t size, std::string &error) override {
+        elements_.clear();
+        if (doc_.Parse(xml, size) != XML_SUCCESS) {
+            error = doc_.ErrorStr();
+            return false;
+        }
+        return true;
+    }
+
+    void run(size_t query, std::vector<uint32_t> &matches) override {
+        matches.clear();
+        uint32_t ordinal = 0;
+        QueryProgram program = queries_[query].program();
+        collect_ordinals(doc_.RootElement(), program,
+                         interner_.resolve(program, doc_), ordinal, matches);
+    }
+
+    void print(uint32_t element, std::ostream &out) override {
+        if (elements_.empty())
+            number(doc_.RootElement());
+        print_node_attributes(out, elements_[element], nullptr);
+    }
+
+  private:
+    void number(const XMLElement *element) {
+        for (; element; element = element->NextSiblingElement()) {
+            elements_.push_back(element);
+            number(element->FirstChildElement());
+        }
+    }
+
+    std::vector<Query> queries_;
+    XMLDocument doc_;
+    QueryInterner interner_;
+    std::vector<const XMLElement *> elements_; // by ordinal, once printed
+};
+
+// The DOM engine behind the byte prefilter: a dump is only parsed once
+// some query's required terms all occur in its bytes, as in a search.
+// Malformed dumps that no query needs go unreported, as they do there.
+class PrefilterEngine : public Engine {
+  public:
+    void set_queries(const std::vector<Query> &queries) override {
+        dom_.set_queries(queries);
+        prefilters_.clear();
+        std::vector<QueryTerm> required;
+        for (const Query &query : queries) {
+            prefilters_.emplace_back(new Prefilter);
+            required.clear();
+            query.required_terms(required);
+            for (const QueryTerm &term : required)
+                prefilters_.back()->require(term);
+        }
+    }
+
+    bool load(const char *xml, size_t size, std::string &error) override {
+        bool any = false;
+        candidate_.assign(prefilters_.size(), false);
+        for (size_t i = 0; i < prefilters_.size(); i++) {
+            const Prefilter &prefilter = *prefilters_[i];
+            candidate_[i] = prefilter.empty() || prefilter.may_match(xml, size);
+            any |= candidate_[i];
+        }
+        return !any || dom_.load(xml, size, error);
+    }
+
+    void run(size_t query, std::vector<uint32_t> &matches) override {
+        if (candidate_[query])
+            dom_.run(query, matches);
+        else
+            matches.clear();
+    }
+
+    void print(uint32_t element, std::ostream &out) override {
+        dom_.print(element, out);
+    }
+
+  private:
+    DomEngine dom_;
+    std::vector<std::unique_ptr<Prefilter>> prefilters_;
+    std::vector<bool> candidate_; // query i may match the current dump
+};
+
+// Parses dumps onto a tape and runs each query as one pass over its
+// elements. Dumps with markup the tape does not cover, and malformed
+// ones, go to the DOM engine instead.
+class TapeEngine : public Engine {
+  public:
+    void set_queries(const std::vector<Query> &queries) override {
+        queries_ = queries;
+        dom_.set_queries(queries);
+    }
+
+    bool load(const char *xml, size_t size, std::string &error) override {
+        on_tape_ = tape_.parse(xml, size);
+        return on_tape_ || dom_.load(xml, size, error);
+    }
+
+    void run(size_t query, std::vector<uint32_t> &matches) override {
+        if (!on_tape_) {
+            dom_.run(query, matches);
+            return;
+        }
+        matches.clear();
+        QueryProgram program = queries_[query].program();
+        for (uint32_t i = 0; i < tape_.size(); i++) {
+            TapeAttributes attributes = {program, tape_, tape_.element(i)};
+            if (run_query(program, attributes))
+                matches.push_back(i);
+        }
+    }
+
+    void print(uint32_t element, std::ostream &out) override {
+        if (on_tape_)
+            tape_.print(element, out);
+        else
+            dom_.print(element, out);
+    }
+
+  private:
+    std::vector<Query> queries_;
+    Tape tape_;
+    bool on_tape_ = false;
+    DomEngine dom_;
+};
+
+// Parses dumps against the uiautomator schema, with each query's
+// attributes resolved to slots up front. Dumps that deviate from the
+// schema go to the DOM engine instead.
+class SchemaEngine : public Engine {
+  public:
+    void set_queries(const std::vector<Query> &queries) override {
+        queries_ = queries;
+        dom_.set_queries(queries);
+        slots_.assign(queries.size() * SCHEMA_KINDS * QUERY_MAX_REGISTERS,
+                      -1);
+        for (size_t i = 0; i < queries.size(); i++) {
+            for (unsigned kind = 0; kind < SCHEMA_KINDS; kind++)
+                schema_slots(queries[i].program(), kind, slots(i, kind));
+        }
+    }
+
+    bool load(const char *xml, size_t size, std::string &error) override {
+        on_schema_ = dump_.parse(xml, size);
+        return on_schema_ || dom_.load(xml, size, error);
+    }
+
+    void run(size_t query, std::vector<uint32_t> &matches) override {
+        if (!on_schema_) {
+            dom_.run(query, matches);
+            return;
+        }
+        matches.clear();
+        QueryProgram program = queries_[query].program();
+        for (uint32_t i = 0; i < dump_.size(); i++) {
+            SchemaAttributes attributes = {
+                dump_, i, slots(query, dump_.element(i).kind)};
+            if (run_query(program, attributes))
+                matches.push_back(i);
+        }
+    }
+
+    void print(uint32_t element, std::ostream &out) override {
+        if (on_schema_)
+            dump_.print(element, out);
+        else
+            dom_.print(element, out);
+    }
+
+  private:
+    int8_t *slots(size_t query, unsigned kind) {
+        return &slots_[(query * SCHEMA_KINDS + kind) * QUERY_MAX_REGISTERS];
+    }
+
+    std::vector<Query> queries_;
+    std::vector<int8_t> slots_; // by query, kind and register
+    SchemaDump dump_;
+    bool on_schema_ = false;
+    DomEngine dom_;
+};
+
+template <typename T> std::unique_ptr<Engine> make_engine() {
+    return std::unique_ptr<Engine>(new T);
+}
+
+std::unique_ptr<Engine> make_lazy_engine() {
+    return std::unique_ptr<Engine>(new DomEngine(true));
+}
+
+std::unique_ptr<Engine> make_interned_engine() {
+    return std::unique_ptr<Engine>(new DomEngine(true, true));
+}
+
+} // namespace
+
+const std::vector<EngineInfo> &engines() {
+    static const std::vector<EngineInfo> list = {
+        {"dom", "tinyxml2 document, walked per query", make_engine<DomEngine>},
+        {"prefilter", "byte prefilter, then the dom engine",
+         make_engine<PrefilterEngine>},
+        {"lazy", "dom engine parsing attributes on first use",
+         make_lazy_engine},
+        {"interned", "lazy engine interning values with few distinct ones",
+         make_interned_engine},
+        {"tape", "structural index and flat tape, dom for the rest",
+         make_engine<TapeEngine>},
+        {"schema", "uiautomator schema with predicted attributes, dom "
+                   "for the rest",
+         make_engine<SchemaEngine>},
+    };
+    return list;
+}
+
+std::unique_ptr<Engine> create_engine(const std::string &name) {
+    for (const EngineInfo &info : engines()) {
+        if (name == info.name)
+            return info.create();
+    }
+    return nullptr;
+}
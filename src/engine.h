@@ -0,0 +1,65 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_ENGINE_H
+#define UIDUMP_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "query.h"
+
+// A way of answering queries over a dump. Every engine must find the
+// same matches as the DOM engine, which is the reference: the elements,
+// numbered in document order from 0 for the root, that each query
+// matches.
+class Engine {
+  public:
+    virtual ~Engine() {}
+
+    // Called once before any dump is loaded.
+    virtual void set_queries(const std::vector<Query> &queries) = 0;
+
+    // Makes size bytes at xml the current dump. They stay valid until the
+    // next load. False, with error set, when the dump is malformed.
+    virtual bool load(const char *xml, size_t size, std::string &error) = 0;
+
+    // Replaces matches with those of query i in the current dump.
+    virtual void run(size_t query, std::vector<uint32_t> &matches) = 0;
+
+    // Prints a matched element of the current dump the way a search
+    // prints its matches.
+    virtual void print(uint32_t element, std::ostream &out) = 0;
+};
+
+struct EngineInfo {
+    const char *name;
+    const char *description;
+    std::unique_ptr<Engine> (*create)();
+};
+
+// Every engine the binary supports, the reference first.
+const std::vector<EngineInfo> &engines();
+
+// Null when there is no engine called name.
+std::unique_ptr<Engine> create_engine(const std::string &name);
+
+#endif // UIDUMP_ENGINE_H
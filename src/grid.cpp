@@ -0,0 +1,156 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "grid.h"
+
+#include <algorithm>
+
+#include "radix.h"
+
+using namespace tinyxml2;
+
+static int interval_lo(const Bounds &b, int axis) {
+    return axis == 0 ? b.top : b.left;
+}
+
+static int interval_hi(const Bounds &b, int axis) {
+    return axis == 0 ? b.bottom : b.right;
+}
+
+static int interval_length(const Bounds &b, int axis) {
+    return interval_hi(b, axis) - interval_lo(b, axis);
+}
+
+// Assigns row (axis 0) or column (axis 1) numbers and returns how many
+// bands were found. Cells more than half again as long as the median
+// cell span several bands, so they are left out of the sweep and later
+// join the band they overlap most; a band is never widened to cover
+// them.
+static unsigned sweep_bands(std::vector<GridCell> &cells, int axis) {
+    if (cells.empty())
+        return 0;
+
+    std::vector<int> lengths(cells.size());
+    for (size_t i = 0; i < cells.size(); i++)
+        lengths[i] = interval_length(cells[i].bounds, axis);
+    std::nth_element(lengths.begin(), lengths.begin() + lengths.size() / 2,
+                     lengths.end());
+    long long median = lengths[lengths.size() / 2];
+
+    std::vector<uint32_t> keys(cells.size()), order(cells.size());
+    for (size_t i = 0; i < cells.size(); i++) {
+        keys[i] = radix_key(interval_lo(cells[i].bounds, axis));
+        order[i] = i;
+    }
+    radix_sort_by_key(keys, order);
+
+    // Each band is anchored on the first cell that opened it.
+    std::vector<std::pair<int, int>> bands;
+    std::vector<uint32_t> band_of(cells.size());
+    std::vector<uint32_t> spanning;
+    for (uint32_t index : order) {
+        const Bounds &b = cells[index].bounds;
+        int lo = interval_lo(b, axis), hi = interval_hi(b, axis);
+        if (2LL * (hi - lo) > 3 * median) {
+            spanning.push_back(index);
+            continue;
+        }
+        if (bands.empty() || !intervals_aligned(bands.back().first,
+                                                bands.back().second, lo, hi))
+            bands.push_back(std::make_pair(lo, hi));
+        band_of[index] = bands.size() - 1;
+    }
+
+    for (uint32_t index : spanning) {
+        const Bounds &b = cells[index].bounds;
+        int lo = interval_lo(b, axis), hi = interval_hi(b, axis);
+        size_t best = bands.size();
+        int best_overlap = 0;
+        for (size_t i = 0; i < bands.size(); i++) {
+            int overlap = std::min(hi, bands[i].second) -
+                          std::max(lo, bands[i].first);
+            if (overlap > best_overlap) {
+                best = i;
+                best_overlap = overlap;
+            }
+        }
+        if (best == bands.size())
+            bands.push_back(std::make_pair(lo, hi));
+        band_of[index] = best;
+    }
+
+    // Bands opened by spanning cells were appended out of order.
+    std::vector<uint32_t> band_keys(bands.size()), band_order(bands.size());
+    for (size_t i = 0; i < bands.size(); i++) {
+        band_keys[i] = radix_key(bands[i].first);
+        band_order[i] = i;
+    }
+    radix_sort_by_key(band_keys, band_order);
+    std::vector<unsigned> rank(bands.size());
+    for (size_t i = 0; i < band_order.size(); i++)
+        rank[band_order[i]] = i;
+
+    for (size_t i = 0; i < cells.size(); i++)
+        (axis == 0 ? cells[i].row : cells[i].column) = rank[band_of[i]];
+    return bands.size();
+}
+
+void layout_grid(std::vector<GridCell> &cells, unsigned &rows,
+                 unsigned &columns) {
+    rows = sweep_bands(cells, 0);
+    columns = sweep_bands(cells, 1);
+}
+
+static void append_values(const XMLElement *element,
+                          const std::vector<std::string> &attributes,
+                          std::string &out) {
+    for (const std::string &name : attributes) {
+        const char *value = element->Attribute(name.c_str());
+        if (!value || !*value)
+            continue;
+        if (!out.empty())
+            out += " / ";
+        out += value;
+    }
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        append_values(child, attributes, out);
+    }
+}
+
+void print_grid(std::ostream &out, const std::vector<GridCell> &cells,
+                unsigned rows, unsigned columns,
+                const std::vector<std::string> &attributes) {
+    std::vector<std::string> table((size_t)rows * columns);
+    for (const GridCell &cell : cells) {
+        std::string &slot = table[(size_t)cell.row * columns + cell.column];
+        std::string value;
+        append_values(cell.element, attributes, value);
+        if (!slot.empty() && !value.empty())
+            slot += " / ";
+        slot += value;
+    }
+
+    for (unsigned row = 0; row < rows; row++) {
+        for (unsigned column = 0; column < columns; column++) {
+            if (column)
+                out << "\t";
+            out << table[(size_t)row * columns + column];
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_GRID_H
+#define UIDUMP_GRID_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bounds.h"
+
+struct GridCell {
+    const tinyxml2::XMLElement *element;
+    Bounds bounds;
+    unsigned row;
+    unsigned column;
+};
+
+// Clusters cells into rows and columns purely from their bounds: cells
+// are swept in order of their top (left) edge and start a new row
+// (column) band whenever they stop lining up with the cell that opened
+// the current one. Cells spanning several bands, such as a header over
+// all columns, are placed in the band they overlap most afterwards.
+void layout_grid(std::vector<GridCell> &cells, unsigned &rows,
+                 unsigned &columns);
+
+// Prints one tab-separated line per row. A cell holds the values of the
+// requested attributes found anywhere in its subtree, joined by " / ".
+void print_grid(std::ostream &out, const std::vector<GridCell> &cells,
+                unsigned rows, unsigned columns,
+                const std::vector<std::string> &attributes);
+
+#endif // UIDUMP_GRID_H
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "identify.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+using namespace tinyxml2;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+enum FeatureKind {
+    FEATURE_ID = 'i',
+    FEATURE_CLASS = 'c',
+    FEATURE_EDGE = 'e',
+};
+
+static uint64_t hash_append(uint64_t h, const char *s) {
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= FNV_PRIME;
+    }
+    h ^= 0xff; // separator that cannot occur in UTF-8
+    return h * FNV_PRIME;
+}
+
+static uint64_t feature_hash(FeatureKind kind, const char *a,
+                             const char *b = "") {
+    uint64_t h = (FNV_OFFSET ^ (uint64_t)kind) * FNV_PRIME;
+    return hash_append(hash_append(h, a), b);
+}
+
+static void collect_features(const XMLElement *element,
+                             const char *parent_class,
+                             std::vector<uint64_t> &out) {
+    const char *resource_id = element->Attribute("resource-id");
+    if (resource_id && *resource_id)
+        out.push_back(feature_hash(FEATURE_ID, resource_id));
+
+    const char *class_name = element->Attribute("class");
+    if (class_name && *class_name) {
+        out.push_back(feature_hash(FEATURE_CLASS, class_name));
+        if (parent_class)
+            out.push_back(feature_hash(FEATURE_EDGE, parent_class, class_name));
+    }
+
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        collect_features(child, class_name, out);
+    }
+}
+
+static void sort_unique(std::vector<uint64_t> &v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+bool ScreenLibrary::load(const char *path, std::string &error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = std::string("could not open ") + path;
+        return false;
+    }
+    return load(in, path, error);
+}
+
+bool ScreenLibrary::load(std::istream &in, const char *path,
+                         std::string &error) {
+    std::vector<uint64_t> features;
+    auto finish_screen = [&]() {
+        if (names_.empty())
+            return;
+        sort_unique(features);
+        uint32_t id = names_.size() - 1;
+        for (uint64_t feature : features)
+            postings_[feature].push_back(id);
+        totals_.push_back(features.size());
+        features.clear();
+    };
+
+    std::string line;
+    for (unsigned lineno = 1; std::getline(in, line); lineno++) {
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+        size_t end = line.find_last_not_of(" \t\r") + 1;
+        size_t space = line.find_first_of(" \t", start);
+        if (space == std::string::npos || space >= end) {
+            std::ostringstream msg;
+            msg << path << ":" << lineno << ": expected <keyword> <value>";
+            error = msg.str();
+            return false;
+        }
+        std::string keyword = line.substr(start, space - start);
+        size_t value_start = line.find_first_not_of(" \t", space);
+        std::string value = line.substr(value_start, end - value_start);
+
+        if (keyword == "screen") {
+            finish_screen();
+            names_.push_back(value);
+            continue;
+        }
+
+        if (names_.empty()) {
+            std::ostringstream msg;
+            msg << path << ":" << lineno << ": '" << keyword
+                << "' before the first 'screen'";
+            error = msg.str();
+            return false;
+        }
+
+        if (keyword == "id") {
+            features.push_back(feature_hash(FEATURE_ID, value.c_str()));
+        } else if (keyword == "class") {
+            features.push_back(feature_hash(FEATURE_CLASS, value.c_str()));
+        } else if (keyword == "edge") {
+            size_t arrow = value.find('>');
+            if (arrow == std::string::npos) {
+                std::ostringstream msg;
+                msg << path << ":" << lineno
+                    << ": edge takes <parent class>><child class>";
+                error = msg.str();
+                return false;
+            }
+            features.push_back(
+                feature_hash(FEATURE_EDGE, value.substr(0, arrow).c_str(),
+                             value.substr(arrow + 1).c_str()));
+        } else {
+            std::ostringstream msg;
+            msg << path << ":" << lineno << ": unknown keyword '" << keyword
+                << "'";
+            error = msg.str();
+            return false;
+        }
+    }
+    finish_screen();
+    return true;
+}
+
+void ScreenLibrary::identify(const XMLElement *root, size_t limit,
+                             double min_coverage, ScreenScratch &scratch,
+                             std::vector<ScreenMatch> &out) const {
+    out.clear();
+    std::vector<uint64_t> &features = scratch.features;
+    std::vector<unsigned> &scores = scratch.scores;
+    features.clear();
+    collect_features(root, nullptr, features);
+    sort_unique(features);
+    if (scores.size() != names_.size())
+        scores.assign(names_.size(), 0);
+
+    scratch.touched.clear();
+    for (uint64_t feature : features) {
+        auto it = postings_.find(feature);
+        if (it == postings_.end())
+            continue;
+        for (uint32_t screen : it->second) {
+            if (scores[screen]++ == 0)
+                scratch.touched.push_back(screen);
+        }
+    }
+
+    for (uint32_t screen : scratch.touched) {
+        ScreenMatch match = {&names_[screen], scores[screen],
+                             totals_[screen]};
+        if (match.score() >= min_coverage)
+            out.push_back(match);
+        scores[screen] = 0;
+    }
+
+    // Best coverage first; among equals prefer the larger signature.
+    auto better = [](const ScreenMatch &a, const ScreenMatch &b) {
+        double sa = a.score(), sb = b.score();
+        if (sa != sb)
+            return sa > sb;
+        return a.total > b.total;
+    };
+    if (out.size() > limit) {
+        std::partial_sort(out.begin(), out.begin() + limit, out.end(), better);
+        out.resize(limit);
+    } else {
+        std::sort(out.begin(), out.end(), better);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_IDENTIFY_H
+#define UIDUMP_IDENTIFY_H
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tinyxml2/tinyxml2.h"
+
+// Share of a screen's signature a dump must show for identify() to
+// name that screen at all.
+const double DEFAULT_MIN_COVERAGE = 0.5;
+
+struct ScreenMatch {
+    const std::string *name;
+    unsigned matched; // signature features present in the dump
+    unsigned total;   // features in the signature
+
+    // A signature lists features a screen is required to have, so what
+    // counts is how many of them the dump shows; whatever else the dump
+    // holds is not held against the screen.
+    double score() const { return total ? (double)matched / total : 0.0; }
+};
+
+// Scratch space for ScreenLibrary::identify(), one per worker so that
+// workers can share a library.
+struct ScreenScratch {
+    std::vector<uint64_t> features;
+    std::vector<unsigned> scores;
+    std::vector<uint32_t> touched;
+};
+
+// A set of known screens, each described by the resource-ids, classes
+// and parent>child class edges it is expected to contain.
+//
+// Library files are plain text:
+//
+//   # comment
+//   screen login
+//   id com.example:id/email
+//   class android.widget.EditText
+//   edge android.widget.LinearLayout>android.widget.EditText
+//
+// Features are compiled into an inverted index from feature hash to the
+// screens that list it, so identifying a dump costs one traversal plus
+// one lookup per distinct feature found in it.
+class ScreenLibrary {
+  public:
+    bool load(const char *path, std::string &error);
+    // The same from a stream; path only names it in errors.
+    bool load(std::istream &in, const char *path, std::string &error);
+
+    // Ranks screens whose score reaches min_coverage, best first, keeping
+    // at most limit of them. Among equal scores the larger signature, the
+    // more specific description, comes first. The library is only read.
+    void identify(const tinyxml2::XMLElement *root, size_t limit,
+                  double min_coverage, ScreenScratch &scratch,
+                  std::vector<ScreenMatch> &out) const;
+
+    size_t size() const { return names_.size(); }
+
+  private:
+    std::vector<std::string> names_;
+    std::vector<unsigned> totals_;
+    std::unordered_map<uint64_t, std::vector<uint32_t>> postings_;
+};
+
+#endif // UIDUMP_IDENTIFY_H
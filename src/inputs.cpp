@@ -0,0 +1,78 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "inputs.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <iostream>
+#include <sys/stat.h>
+
+bool has_xml_suffix(const std::string &name) {
+    return name.size() > 4 && name.compare(name.size() - 4, 4, ".xml") == 0;
+}
+
+static bool walk_directory(const std::string &dir,
+                           std::vector<std::string> &out) {
+    DIR *handle = opendir(dir.c_str());
+    if (!handle) {
+        std::cerr << "Error: could not open directory " << dir << "\n";
+        return false;
+    }
+
+    std::vector<std::string> subdirs;
+    size_t first = out.size();
+    while (struct dirent *entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = dir + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            subdirs.push_back(path);
+        else if (S_ISREG(st.st_mode) && has_xml_suffix(name))
+            out.push_back(path);
+    }
+    closedir(handle);
+
+    std::sort(out.begin() + first, out.end());
+    std::sort(subdirs.begin(), subdirs.end());
+    for (const std::string &subdir : subdirs) {
+        if (!walk_directory(subdir, out))
+            return false;
+    }
+    return true;
+}
+
+bool expand_inputs(const std::vector<std::string> &paths,
+                   std::vector<std::string> &out) {
+    for (const std::string &path : paths) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            std::string dir = path;
+            while (dir.size() > 1 && dir[dir.size() - 1] == '/')
+                dir.erase(dir.size() - 1);
+            if (!walk_directory(dir, out))
+                return false;
+        } else {
+            out.push_back(path);
+        }
+    }
+    return true;
+}
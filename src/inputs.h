@@ -0,0 +1,32 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_INPUTS_H
+#define UIDUMP_INPUTS_H
+
+#include <string>
+#include <vector>
+
+bool has_xml_suffix(const std::string &name);
+
+// Expands the paths given on the command line into the list of dumps to
+// read. Files are kept as given; directories are searched recursively for
+// *.xml files, which are appended in sorted order.
+bool expand_inputs(const std::vector<std::string> &paths,
+                   std::vector<std::string> &out);
+
+#endif // UIDUMP_INPUTS_H
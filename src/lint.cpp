@@ -0,0 +1,381 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lint.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <set>
+#include <unordered_set>
+
+#include "bounds.h"
+
+using namespace tinyxml2;
+
+const char *lint_rule_name(LintRule rule) {
+    switch (rule) {
+    case LINT_MISSING_DESCRIPTION:
+        return "missing-content-desc";
+    case LINT_SMALL_TARGET:
+        return "small-touch-target";
+    case LINT_OVERLAPPING_TARGETS:
+        return "overlapping-touch-targets";
+    case LINT_DUPLICATE_DESCRIPTION:
+        return "duplicate-content-desc";
+    default:
+        return "unknown";
+    }
+}
+
+static bool is_true(const XMLElement *element, const char *name) {
+    const char *value = element->Attribute(name);
+    return value && strcmp(value, "true") == 0;
+}
+
+static bool is_empty(const char *value) { return !value || !*value; }
+
+static bool is_image(const char *class_name) {
+    return class_name && (strstr(class_name, "ImageView") ||
+                          strstr(class_name, "ImageButton"));
+}
+
+namespace {
+
+struct Target {
+    Bounds bounds;
+    const XMLElement *element;
+    unsigned first; // preorder number of the node
+    unsigned last;  // preorder number of its last descendant
+};
+
+struct Walker {
+    const LintOptions &options;
+    std::vector<LintFinding> &out;
+    std::vector<Target> targets;
+    std::unordered_set<std::string> descriptions;
+    unsigned order;
+
+    void add(LintRule rule, const XMLElement *element,
+             const XMLElement *other = nullptr) {
+        LintFinding finding = {rule, element, other};
+        out.push_back(finding);
+    }
+
+    void visit(const XMLElement *element) {
+        unsigned first = order++;
+        size_t target = targets.size();
+
+        if (is_true(element, "clickable")) {
+            const char *class_name = element->Attribute("class");
+            if (is_image(class_name) &&
+                is_empty(element->Attribute("content-desc")) &&
+                is_empty(element->Attribute("text")))
+                add(LINT_MISSING_DESCRIPTION, element);
+
+            Target t;
+            if (element_bounds(element, t.bounds) && t.bounds.area() > 0) {
+                if (t.bounds.width() < options.min_target_size ||
+                    t.bounds.height() < options.min_target_size)
+                    add(LINT_SMALL_TARGET, element);
+                t.element = element;
+                t.first = first;
+                targets.push_back(t);
+            }
+        }
+
+        // Sibling descriptions are checked from the parent so the set can
+        // be reused without keeping one per level alive.
+        descriptions.clear();
+        for (const XMLElement *child = element->FirstChildElement();
+             child != nullptr; child = child->NextSiblingElement()) {
+            const char *desc = child->Attribute("content-desc");
+            if (!is_empty(desc) && !descriptions.insert(desc).second)
+                add(LINT_DUPLICATE_DESCRIPTION, child);
+        }
+
+        for (const XMLElement *child = element->FirstChildElement();
+             child != nullptr; child = child->NextSiblingElement()) {
+            visit(child);
+        }
+
+        if (target < targets.size() && targets[target].element == element)
+            targets[target].last = order - 1;
+    }
+};
+
+} // namespace
+
+static bool related(const Target &a, const Target &b) {
+    return (a.first <= b.first && b.first <= a.last) ||
+           (b.first <= a.first && a.first <= b.last);
+}
+
+namespace {
+
+// The [top, bottom) intervals of the targets crossing the sweep line,
+// by index into the targets, organized so that finding those that
+// overlap a new target vertically costs a logarithmic search plus the
+// ones found. An interval overlaps [top, bottom) when it contains top or
+// starts inside (top, bottom): a segment tree over the distinct y
+// coordinates answers the first, a set ordered by top the second.
+class ActiveIntervals {
+  public:
+    explicit ActiveIntervals(const std::vector<Target> &targets)
+        : targets_(targets), removed_(targets.size(), false) {
+        for (const Target &t : targets) {
+            ys_.push_back(t.bounds.top);
+            ys_.push_back(t.bounds.bottom);
+        }
+        std::sort(ys_.begin(), ys_.end());
+        ys_.erase(std::unique(ys_.begin(), ys_.end()), ys_.end());
+        nodes_.resize(ys_.size() * 4);
+    }
+
+    void insert(size_t i) {
+        const Bounds &b = targets_[i].bounds;
+        cover(1, 0, ys_.size() - 1, slot(b.top), slot(b.bottom), i);
+        by_top_.insert(std::make_pair(b.top, i));
+    }
+
+    // Entries in the tree are dropped lazily, when a search meets them.
+    void erase(size_t i) {
+        removed_[i] = true;
+        by_top_.erase(std::make_pair(targets_[i].bounds.top, i));
+    }
+
+    void overlapping(const Bounds &b, std::vector<size_t> &out) {
+        stab(1, 0, ys_.size() - 1, slot(b.top), out);
+        auto end = by_top_.lower_bound(std::make_pair(b.bottom, (size_t)0));
+        for (auto it = by_top_.upper_bound(std::make_pair(b.top, SIZE_MAX));
+             it != end; ++it)
+            out.push_back(it->second);
+    }
+
+  private:
+    size_t slot(int y) const {
+        return std::lower_bound(ys_.begin(), ys_.end(), y) - ys_.begin();
+    }
+
+    // node covers the elementary intervals [lo, hi), between ys_[lo] and
+    // ys_[hi]. Interval i is stored at the nodes that exactly cover
+    // [from, to).
+    void cover(size_t node, size_t lo, size_t hi, size_t from, size_t to,
+               size_t i) {
+        if (to <= lo || hi <= from)
+            return;
+        if (from <= lo && hi <= to) {
+            nodes_[node].push_back(i);
+            return;
+        }
+        size_t mid = (lo + hi) / 2;
+        cover(node * 2, lo, mid, from, to, i);
+        cover(node * 2 + 1, mid, hi, from, to, i);
+    }
+
+    // Collects the intervals containing elementary interval at, the one
+    // starting at ys_[at].
+    void stab(size_t node, size_t lo, size_t hi, size_t at,
+              std::vector<size_t> &out) {
+        if (at < lo || hi <= at)
+            return;
+        std::vector<size_t> &here = nodes_[node];
+        size_t kept = 0;
+        for (size_t i : here) {
+            if (removed_[i])
+                continue;
+            here[kept++] = i;
+            out.push_back(i);
+        }
+        here.resize(kept);
+        if (hi - lo > 1) {
+            size_t mid = (lo + hi) / 2;
+            stab(node * 2, lo, mid, at, out);
+            stab(node * 2 + 1, mid, hi, at, out);
+        }
+    }
+
+    const std::vector<Target> &targets_;
+    std::vector<bool> removed_;
+    std::vector<int> ys_;
+    std::vector<std::vector<size_t>> nodes_;
+    std::set<std::pair<int, size_t>> by_top_;
+};
+
+} // namespace
+
+// Sweep a vertical line left to right over the target rectangles. Only
+// rectangles still crossing the line are kept, and of those only the
+// ones overlapping a target vertically are looked at, so the cost
+// follows the number of overlapping pairs rather than all pairs, even
+// for a long list of full-width rows.
+static void find_overlaps(std::vector<Target> &targets,
+                          std::vector<LintFinding> &out) {
+    std::sort(targets.begin(), targets.end(),
+              [](const Target &a, const Target &b) {
+                  return a.bounds.left < b.bounds.left;
+              });
+
+    ActiveIntervals active(targets);
+    auto ends_later = [&](size_t a, size_t b) {
+        return targets[a].bounds.right > targets[b].bounds.right;
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(ends_later)>
+        by_right(ends_later);
+    std::vector<size_t> found;
+    for (size_t i = 0; i < targets.size(); i++) {
+        const Target &t = targets[i];
+        while (!by_right.empty() &&
+               targets[by_right.top()].bounds.right <= t.bounds.left) {
+            active.erase(by_right.top()); // the line has moved past it
+            by_right.pop();
+        }
+
+        found.clear();
+        active.overlapping(t.bounds, found);
+        // In the order the sweep met them.
+        std::sort(found.begin(), found.end());
+        for (size_t j : found) {
+            const Target &other = targets[j];
+            if (!related(other, t)) {
+                LintFinding finding = {LINT_OVERLAPPING_TARGETS, other.element,
+                                       t.element};
+                out.push_back(finding);
+            }
+        }
+        active.insert(i);
+        by_right.push(i);
+    }
+}
+
+void lint_tree(const XMLElement *root, const LintOptions &options,
+               std::vector<LintFinding> &out) {
+    Walker walker = {options, out, {}, {}, 0};
+    walker.visit(root);
+    find_overlaps(walker.targets, out);
+}
+
+static const char *describe(const XMLElement *element) {
+    const char *resource_id = element->Attribute("resource-id");
+    if (!is_empty(resource_id))
+        return resource_id;
+    const char *class_name = element->Attribute("class");
+    return class_name ? class_name : element->Name();
+}
+
+static void print_node(std::ostream &out, const XMLElement *element) {
+    const char *bounds = element->Attribute("bounds");
+    out << describe(element) << " " << (bounds ? bounds : "");
+}
+
+void print_lint_finding(std::ostream &out, const LintFinding &finding) {
+    out << lint_rule_name(finding.rule) << ": ";
+    print_node(out, finding.element);
+    if (finding.other) {
+        out << " and ";
+        print_node(out, finding.other);
+    }
+    if (finding.rule == LINT_DUPLICATE_DESCRIPTION)
+        out << " \"" << finding.element->Attribute("content-desc") << "\"";
+    out << "\n";
+}
+
+void LintSummary::add(const std::vector<LintFinding> &findings) {
+    bool seen[LINT_RULE_COUNT] = {};
+    files_++;
+    if (!findings.empty())
+        files_with_findings_++;
+    for (const LintFinding &finding : findings) {
+        counts_[finding.rule]++;
+        if (!seen[finding.rule]) {
+            seen[finding.rule] = true;
+            files_per_rule_[finding.rule]++;
+        }
+        offenders_[finding.rule][describe(finding.element)]++;
+    }
+}
+
+void LintSummary::merge(const LintSummary &other) {
+    files_ += other.files_;
+    files_with_findings_ += other.files_with_findings_;
+    for (int rule = 0; rule < LINT_RULE_COUNT; rule++) {
+        counts_[rule] += other.counts_[rule];
+        files_per_rule_[rule] += other.files_per_rule_[rule];
+        for (const auto &offender : other.offenders_[rule])
+            offenders_[rule][offender.first] += offender.second;
+    }
+}
+
+void LintSummary::print(std::ostream &out, size_t top) const {
+    out << "Summary: " << files_with_findings_ << " of " << files_
+        << " file(s) with findings\n";
+    for (int rule = 0; rule < LINT_RULE_COUNT; rule++) {
+        out << "  " << lint_rule_name((LintRule)rule) << ": "
+            << counts_[rule] << " in " << files_per_rule_[rule]
+            << " file(s)\n";
+
+        std::vector<std::pair<unsigned, std::string>> worst;
+        for (const auto &offender : offenders_[rule])
+            worst.push_back(std::make_pair(offender.second, offender.first));
+        size_t shown = std::min(top, worst.size());
+        std::partial_sort(
+            worst.begin(), worst.begin() + shown, worst.end(),
+            [](const std::pair<unsigned, std::string> &a,
+               const std::pair<unsigned, std::string> &b) {
+                return a.first > b.first;
+            });
+        for (size_t i = 0; i < shown; i++)
+            out << "    " << worst[i].first << "  " << worst[i].second
+                << "\n";
+    }
+}
+
+// One line of file totals, then per rule its counts and offenders, each
+// offender as "<findings> <name length> <name>".
+void LintSummary::write(std::ostream &out) const {
+    out << files_ << " " << files_with_findings_ << "\n";
+    for (int rule = 0; rule < LINT_RULE_COUNT; rule++) {
+        out << counts_[rule] << " " << files_per_rule_[rule] << " "
+            << offenders_[rule].size() << "\n";
+        for (const auto &offender : offenders_[rule])
+            out << offender.second << " " << offender.first.size() << " "
+                << offender.first << "\n";
+    }
+}
+
+bool LintSummary::read(std::istream &in) {
+    *this = LintSummary();
+    if (!(in >> files_ >> files_with_findings_))
+        return false;
+    for (int rule = 0; rule < LINT_RULE_COUNT; rule++) {
+        size_t offenders;
+        if (!(in >> counts_[rule] >> files_per_rule_[rule] >> offenders))
+            return false;
+        for (size_t i = 0; i < offenders; i++) {
+            unsigned count;
+            size_t length;
+            if (!(in >> count >> length) || in.get() != ' ')
+                return false;
+            std::string name(length, '\0');
+            if (!in.read(&name[0], length))
+                return false;
+            offenders_[rule][name] = count;
+        }
+    }
+    return true;
+}
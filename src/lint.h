@@ -0,0 +1,76 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_LINT_H
+#define UIDUMP_LINT_H
+
+#include <map>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "tinyxml2/tinyxml2.h"
+
+enum LintRule {
+    LINT_MISSING_DESCRIPTION,
+    LINT_SMALL_TARGET,
+    LINT_OVERLAPPING_TARGETS,
+    LINT_DUPLICATE_DESCRIPTION,
+    LINT_RULE_COUNT,
+};
+
+const char *lint_rule_name(LintRule rule);
+
+struct LintOptions {
+    int min_target_size = 48; // pixels, both width and height
+};
+
+struct LintFinding {
+    LintRule rule;
+    const tinyxml2::XMLElement *element;
+    const tinyxml2::XMLElement *other; // second node for pair rules
+};
+
+// Runs every rule in a single walk of the tree. Overlapping clickable
+// regions are found afterwards with a sweep over the collected bounds.
+void lint_tree(const tinyxml2::XMLElement *root, const LintOptions &options,
+               std::vector<LintFinding> &out);
+
+void print_lint_finding(std::ostream &out, const LintFinding &finding);
+
+// Totals across every file of a batch run.
+class LintSummary {
+  public:
+    void add(const std::vector<LintFinding> &findings);
+    void merge(const LintSummary &other);
+    void print(std::ostream &out, size_t top) const;
+
+    // Plain text form, so the totals of separate runs can be merged.
+    void write(std::ostream &out) const;
+    bool read(std::istream &in);
+
+  private:
+    unsigned files_ = 0;
+    unsigned files_with_findings_ = 0;
+    unsigned counts_[LINT_RULE_COUNT] = {};
+    unsigned files_per_rule_[LINT_RULE_COUNT] = {};
+    // Findings per offending resource-id (or class when it has none).
+    std::map<std::string, unsigned> offenders_[LINT_RULE_COUNT];
+};
+
+#endif // UIDUMP_LINT_H
@@ -15,32 +15,93 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cstdarg>
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <fstream>
+#include <functional>
 #include <getopt.h>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "alloc_stats.h"
+#include "archive.h"
+#include "bloom_index.h"
+#include "checkpoint.h"
+#include "debug.h"
+#include "difftest.h"
+#include "grid.h"
+#include "identify.h"
+#include "inputs.h"
+#include "lint.h"
+#include "mapped_file.h"
+#include "order.h"
+#include "parallel.h"
+#include "partial.h"
+#include "prefilter.h"
+#include "progress.h"
+#include "query.h"
+#include "query_plan.h"
+#include "replay.h"
+#include "scaling.h"
+#include "search.h"
+#include "self_bench.h"
+#include "spatial.h"
+#include "stitch.h"
+#include "tape.h"
+#include "text_dump.h"
 #include "tinyxml2/tinyxml2.h"
 
 using namespace tinyxml2;
 
-int debug = 0;
+// Searches --alloc-test runs before counting, and then counts over.
+const unsigned ALLOC_TEST_WARMUP = 3;
+const unsigned ALLOC_TEST_ITERATIONS = 1000;
 
-void dprint(const char *format, ...) {
-    if (!debug)
-        return;
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-}
+// Options that only have a long form.
+enum {
+    OPT_NEAREST = 256,
+    OPT_TARGET,
+    OPT_K,
+    OPT_DIRECTION,
+    OPT_STITCH,
+    OPT_IDENTIFY,
+    OPT_LINT,
+    OPT_MIN_TARGET_SIZE,
+    OPT_TEXT_DUMP,
+    OPT_GRID,
+    OPT_GRID_CELLS,
+    OPT_COLUMNS,
+    OPT_ORDER_BY,
+    OPT_TOP,
+    OPT_QUERY_FILE,
+    OPT_PLAN_CACHE,
+    OPT_NO_PREFILTER,
+    OPT_BUILD_INDEX,
+    OPT_SHARD,
+    OPT_MERGE,
+    OPT_CHECKPOINT,
+    OPT_RESUME,
+    OPT_PROGRESS,
+    OPT_PROGRESS_JSON,
+    OPT_ALLOC_STATS,
+    OPT_ALLOC_TEST,
+    OPT_REPLAY_BENCH,
+    OPT_SCALING_BENCH,
+    OPT_SELF_BENCH,
+    OPT_DIFF_TEST,
+    OPT_MIN_COVERAGE,
+};
 
 void print_help() {
-    std::cout << "Usage: uidump-parser --file <xml_file> [OPTIONS]\n";
+    std::cout << "Usage: uidump-parser --file <xml_file> [OPTIONS] "
+                 "[xml_file...]\n";
     std::cout << "Options:\n";
-    std::cout << "  --file, -f <xml_file>            : Path to the XML file to "
-                 "parse (required)\n";
+    std::cout << "  --file, -f <xml_file>            : Path to the XML file, "
+                 "directory or .zip/.tar/.tar.gz archive to parse "
+                 "(required, may be repeated)\n";
     std::cout << "  --resource-id, -r <id>           : Search for a node with "
                  "the given resource-id\n";
     std::cout << "  --class, -c <class_name>         : Search for a node with "
@@ -49,14 +110,86 @@ void print_help() {
                  "the given text value\n";
     std::cout << "  --filter-attribute, -F <attr=val>: Filter by any attribute "
                  "dynamically (e.g., package, content-desc)\n";
+    std::cout << "  --query, -q <query>              : Search for nodes "
+                 "matching a boolean query (see below)\n";
+    std::cout << "  --query-file <file>              : Run every query in "
+                 "<file>, one 'name: query' per line\n";
+    std::cout << "  --plan-cache <file>              : Where the compiled "
+                 "query file is cached (default: <file>.plan)\n";
     std::cout << "  --print-only, -p <attribute>     : Print only the "
                  "specified attribute for matched nodes\n";
     std::cout << "  --bounds, -b                     : Print bounds for "
                  "matched nodes\n";
+    std::cout << "  --order-by <key>                 : Sort matches by area, x, "
+                 "y or an attribute ('-' prefix: descending)\n";
+    std::cout << "  --top <count>                    : Print only the first "
+                 "<count> matches in that order\n";
+    std::cout << "  --nearest <query>                : Report the nodes closest "
+                 "to each node matching the query\n";
+    std::cout << "  --target <query>                 : Candidates considered "
+                 "by --nearest (required with it)\n";
+    std::cout << "  --k <count>                      : Number of nearest "
+                 "nodes to report (default: 1)\n";
+    std::cout << "  --direction <dir>                : Restrict --nearest to "
+                 "right-of, left-of, below or above\n";
+    std::cout << "  --stitch <query>                 : Join the children of "
+                 "the matching list across all files\n";
+    std::cout << "  --identify <library>             : Name the known screen "
+                 "each file shows\n";
+    std::cout << "  --min-coverage <fraction>        : Share of a screen's "
+                 "features --identify requires (default: 0.5)\n";
+    std::cout << "  --lint                           : Report accessibility "
+                 "problems, with a summary for batches\n";
+    std::cout << "  --min-target-size <px>           : Smallest touch target "
+                 "--lint accepts (default: 48)\n";
+    std::cout << "  --text-dump                      : Print all text on "
+                 "screen in reading order\n";
+    std::cout << "  --grid <query>                   : Print the children of "
+                 "matching containers as a table\n";
+    std::cout << "  --grid-cells <query>             : Print all matching "
+                 "nodes as one table\n";
+    std::cout << "  --columns <attr,...>             : Attributes shown in "
+                 "table cells (default: text)\n";
+    std::cout << "  --no-prefilter                   : Parse every file, even "
+                 "ones whose bytes cannot match\n";
+    std::cout << "  --build-index                    : Write or refresh the "
+                 "sidecar index of each input directory\n";
+    std::cout << "  --jobs, -j <count>               : Worker threads for "
+                 "batch work (default: one per core)\n";
+    std::cout << "  --shard <i/N>                    : Process only part i of N "
+                 "of the inputs, writing a partial output\n";
+    std::cout << "  --merge                          : Combine the partial "
+                 "outputs given as arguments\n";
+    std::cout << "  --checkpoint <file>              : Keep progress and "
+                 "results in <file>, printing them at the end\n";
+    std::cout << "  --resume                         : Continue the run "
+                 "recorded in the --checkpoint file\n";
+    std::cout << "  --progress                       : Report throughput and "
+                 "an ETA on stderr every second\n";
+    std::cout << "  --progress-json <file>           : Append the same "
+                 "report to <file> as JSON lines\n";
+    std::cout << "  --alloc-stats                    : Print heap and pool "
+                 "allocation counts on exit\n";
+    std::cout << "  --alloc-test                     : Fail if searching the "
+                 "first file again allocates after warmup\n";
+    std::cout << "  --replay-bench <query_file>      : Time every engine on "
+                 "the dumps with the queries in <query_file>\n";
+    std::cout << "  --scaling-bench                  : Time the search at 1, "
+                 "2, 4 ... --jobs threads and show where time goes\n";
+    std::cout << "  --self-bench                     : Benchmark parsing and "
+                 "queries on generated dumps, print one line\n";
+    std::cout << "  --diff-test <cases>              : Check every engine "
+                 "against the DOM on generated dumps\n";
     std::cout << "  --debug, -d                      : Enable debug mode for "
                  "verbose output\n";
     std::cout << "  --help, -h                       : Show this help message "
                  "and exit\n";
+    std::cout << "\nQueries:\n";
+    std::cout << "  <attr>=<value>, <attr>!=<value>, <attr>~<substring>, "
+                 "<attr>^=<prefix>, or a bare\n";
+    std::cout << "  <attr> for a non-empty attribute; combine with !, &&, || "
+                 "and parentheses.\n";
+    std::cout << "  Quote values containing spaces: text=\"Sign in\"\n";
     std::cout << "\nExamples:\n";
     std::cout << "  ./uidump-parser --file dump.xml --resource-id com.example "
                  "--print-only bounds --debug\n";
@@ -66,127 +199,393 @@ void print_help() {
                  "android.widget.TextView --filter-attribute enabled=true\n";
     std::cout << "  ./uidump-parser --file dump.xml --text Instagram "
                  "--filter-attribute package=com.example --bounds\n";
+    std::cout << "  ./uidump-parser --file dump.xml --query "
+                 "'(class=android.widget.Button || "
+                 "class=android.widget.ImageButton) && enabled=true && "
+                 "text'\n";
+    std::cout << "  ./uidump-parser --file dump.xml --filter-attribute "
+                 "clickable=true --order-by -area --top 5\n";
+    std::cout << "  ./uidump-parser --file dump.xml --nearest text=Email "
+                 "--target class=android.widget.EditText --direction "
+                 "right-of\n";
+    std::cout << "  ./uidump-parser --stitch resource-id=com.example:id/list "
+                 "--print-only text scroll1.xml scroll2.xml\n";
+    std::cout << "  ./uidump-parser --lint --min-target-size 144 dumps/\n";
+    std::cout << "  ./uidump-parser --build-index dumps/ && ./uidump-parser "
+                 "--resource-id com.example:id/login dumps/\n";
+    std::cout << "  ./uidump-parser --shard 1/2 --lint dumps/ > part1; "
+                 "./uidump-parser --merge part*\n";
+    std::cout << "  ./uidump-parser --replay-bench queries.txt captured/\n";
+    std::cout << "  ./uidump-parser --scaling-bench -j 64 --lint dumps/\n";
+    std::cout << "  adb shell /data/local/tmp/uidump-parser --self-bench\n";
+    std::cout << "  ./uidump-parser --file dump.xml --grid "
+                 "resource-id=com.example:id/products --columns "
+                 "text,content-desc\n";
 }
 
-void print_node_attributes(const XMLElement *element, const char *only_print) {
-    dprint("Processing node: %s\n", element->Name());
+void find_nearest_nodes(std::ostream &out, const XMLElement *root,
+                        const QueryProgram &anchor_query,
+                        const QueryProgram &target_query, size_t k,
+                        Direction direction, const char *only_print) {
+    std::vector<const XMLElement *> anchors, targets;
+    collect_matching(root, anchor_query, anchors);
+    collect_matching(root, target_query, targets);
 
-    if (only_print && strlen(only_print) > 0) {
-        const char *attr = element->Attribute(only_print);
-        if (attr) {
-            std::cout << only_print << ": " << attr << "\n";
-        } else {
-            std::cout << "Attribute '" << only_print << "' not found on node "
-                      << element->Name() << "\n";
-        }
-        return;
+    std::vector<SpatialEntry> entries;
+    entries.reserve(targets.size());
+    for (const XMLElement *target : targets) {
+        SpatialEntry entry;
+        entry.element = target;
+        if (element_bounds(target, entry.bounds))
+            entries.push_back(entry);
     }
+    dprint("Indexed %zu of %zu target nodes\n", entries.size(),
+           targets.size());
 
-    std::cout << "Node: " << element->Name() << "\n";
-    bool hasAttributes = false;
+    SpatialIndex index(entries);
+    std::vector<SpatialHit> hits;
+    for (const XMLElement *element : anchors) {
+        SpatialEntry anchor;
+        anchor.element = element;
+        if (!element_bounds(element, anchor.bounds)) {
+            dprint("Skipping anchor without bounds\n");
+            continue;
+        }
+        index.nearest(anchor, k, direction, hits);
+        dprint("Anchor %s: %zu hit(s)\n", element->Attribute("bounds"),
+               hits.size());
+        for (const SpatialHit &hit : hits) {
+            dprint("Gap: %lld px^2\n", hit.gap);
+            print_node_attributes(out, hit.entry->element, only_print);
+        }
+    }
+}
 
-    for (const XMLAttribute *attr = element->FirstAttribute(); attr;
-         attr = attr->Next()) {
-        hasAttributes = true;
-        std::cout << "  " << attr->Name() << ": " << attr->Value() << "\n";
+void print_subtree(std::ostream &out, const XMLElement *element,
+                   const char *only_print) {
+    print_node_attributes(out, element, only_print);
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        print_subtree(out, child, only_print);
     }
+}
 
-    if (!hasAttributes) {
-        std::cout << "  No attributes found for node: " << element->Name()
-                  << "\n";
+int stitch_lists(const std::vector<std::string> &xml_files,
+                 const QueryProgram &container_query, const char *only_print) {
+    ListStitcher stitcher;
+    std::vector<const XMLElement *> containers, items;
+
+    for (const std::string &xml_file : xml_files) {
+        XMLDocument doc;
+        if (doc.LoadFile(xml_file.c_str()) != XML_SUCCESS) {
+            std::cerr << "Error: could not parse file " << xml_file << "\n";
+            return 1;
+        }
+
+        containers.clear();
+        collect_matching(doc.RootElement(), container_query, containers);
+        if (containers.empty()) {
+            std::cerr << "Error: no list matching the query in " << xml_file
+                      << "\n";
+            return 1;
+        }
+
+        items.clear();
+        for (const XMLElement *child = containers[0]->FirstChildElement();
+             child != nullptr; child = child->NextSiblingElement()) {
+            items.push_back(child);
+        }
+
+        size_t seen = stitcher.add(items);
+        dprint("%s: %zu item(s), %zu overlapping the previous dump\n",
+               xml_file.c_str(), items.size(), seen);
+        for (size_t i = seen; i < items.size(); i++) {
+            std::cout << "Item " << stitcher.total() - (items.size() - i)
+                      << ":\n";
+            print_subtree(std::cout, items[i], only_print);
+        }
     }
 
-    std::cout << "\n";
+    dprint("Stitched %zu item(s) from %zu file(s)\n", stitcher.total(),
+           xml_files.size());
+    return 0;
 }
 
-bool node_matches_additional_filter(const XMLElement *element,
-                                    const std::string &filter_attribute,
-                                    const std::string &filter_value) {
-    if (!filter_attribute.empty() && !filter_value.empty()) {
-        const char *attr_value = element->Attribute(filter_attribute.c_str());
-        return attr_value && filter_value == attr_value;
+void identify_screen(std::ostream &out, const ScreenLibrary &library,
+                     double min_coverage, ScreenScratch &scratch,
+                     const XMLElement *root) {
+    std::vector<ScreenMatch> matches;
+    library.identify(root, debug ? 5 : 1, min_coverage, scratch, matches);
+
+    if (matches.empty()) {
+        out << "Screen: unknown\n";
+        return;
+    }
+
+    out << "Screen: " << *matches[0].name << " (" << matches[0].matched
+        << "/" << matches[0].total << " features)\n";
+    for (size_t i = 1; i < matches.size(); i++) {
+        dprint("Candidate: %s (%u/%u)\n", matches[i].name->c_str(),
+               matches[i].matched, matches[i].total);
     }
-    return true;
 }
 
-void find_node_by_resource_id(const XMLElement *element,
-                              const std::string &resource_id,
-                              const char *only_print,
-                              const std::string &filter_attribute = "",
-                              const std::string &filter_value = "") {
-    const char *res_id_attr = element->Attribute("resource-id");
+void print_grid_of(std::ostream &out,
+                   const std::vector<const XMLElement *> &nodes,
+                   const std::vector<std::string> &columns) {
+    std::vector<GridCell> cells;
+    for (const XMLElement *node : nodes) {
+        GridCell cell;
+        cell.element = node;
+        if (element_bounds(node, cell.bounds) && cell.bounds.area() > 0)
+            cells.push_back(cell);
+    }
+
+    unsigned rows, cols;
+    layout_grid(cells, rows, cols);
+    dprint("Grid of %zu cell(s): %u row(s) x %u column(s)\n", cells.size(),
+           rows, cols);
+    print_grid(out, cells, rows, cols, columns);
+}
 
-    if (res_id_attr && resource_id == res_id_attr) {
-        if (node_matches_additional_filter(element, filter_attribute,
-                                           filter_value)) {
-            print_node_attributes(element, only_print);
+void find_grids(std::ostream &out, const XMLElement *root,
+                const QueryProgram &container_query,
+                const std::vector<std::string> &columns) {
+    std::vector<const XMLElement *> containers, children;
+    collect_matching(root, container_query, containers);
+    for (const XMLElement *container : containers) {
+        if (container != containers[0])
+            out << "\n";
+        children.clear();
+        for (const XMLElement *child = container->FirstChildElement();
+             child != nullptr; child = child->NextSiblingElement()) {
+            children.push_back(child);
         }
+        print_grid_of(out, children, columns);
     }
+}
 
-    for (const XMLElement *child = element->FirstChildElement();
+// Matches of each query of a plan, by query index.
+typedef std::vector<std::vector<const XMLElement *>> PlanMatches;
+
+void run_query_plan(const XMLElement *root, const QueryPlan &plan,
+                    PlanMatches &matches) {
+    for (size_t i = 0; i < plan.size(); i++) {
+        if (query_matches(plan.program(i), root))
+            matches[i].push_back(root);
+    }
+    for (const XMLElement *child = root->FirstChildElement();
          child != nullptr; child = child->NextSiblingElement()) {
-        find_node_by_resource_id(child, resource_id, only_print,
-                                 filter_attribute, filter_value);
+        run_query_plan(child, plan, matches);
     }
 }
 
-void find_node_by_class(const XMLElement *element,
-                        const std::string &class_name, const char *only_print,
-                        const std::string &filter_attribute = "",
-                        const std::string &filter_value = "") {
-    const char *class_attr = element->Attribute("class");
-    if (class_attr && class_name == class_attr) {
-        if (node_matches_additional_filter(element, filter_attribute,
-                                           filter_value)) {
-            print_node_attributes(element, only_print);
+// Prints each query's matches under its name. Like a single query, the
+// matches must pass the --filter-attribute test and, when top_matches is
+// set, only the best of them are printed, ranked within each query.
+void find_nodes_by_plan(std::ostream &out, const XMLElement *root,
+                        const QueryPlan &plan, const char *only_print,
+                        const std::string &filter_attribute,
+                        const std::string &filter_value, PlanMatches &matches,
+                        std::vector<const XMLElement *> &ranked) {
+    matches.resize(plan.size());
+    for (std::vector<const XMLElement *> &query_matches : matches)
+        query_matches.clear();
+    run_query_plan(root, plan, matches);
+    for (size_t i = 0; i < plan.size(); i++) {
+        std::vector<const XMLElement *> &found = matches[i];
+        found.erase(std::remove_if(found.begin(), found.end(),
+                                   [&](const XMLElement *element) {
+                                       return !node_matches_additional_filter(
+                                           element, filter_attribute,
+                                           filter_value);
+                                   }),
+                    found.end());
+        if (found.empty())
+            continue;
+        out << "Query: " << plan.name(i) << "\n";
+        for (const XMLElement *element : found)
+            report_match(out, element, only_print);
+        if (top_matches) {
+            top_matches->take(ranked);
+            for (const XMLElement *element : ranked)
+                print_node_attributes(out, element, only_print);
         }
     }
+}
 
-    for (const XMLElement *child = element->FirstChildElement();
-         child != nullptr; child = child->NextSiblingElement()) {
-        find_node_by_class(child, class_name, only_print, filter_attribute,
-                           filter_value);
+// The same over a dump parsed onto a tape; matches holds element ordinals.
+void find_nodes_by_plan(std::ostream &out, Tape &tape, const QueryPlan &plan,
+                        const char *only_print,
+                        std::vector<std::vector<uint32_t>> &matches) {
+    matches.resize(plan.size());
+    for (std::vector<uint32_t> &query_matches : matches)
+        query_matches.clear();
+    for (uint32_t element = 0; element < tape.size(); element++) {
+        for (size_t i = 0; i < plan.size(); i++) {
+            QueryProgram program = plan.program(i);
+            TapeAttributes attributes = {program, tape,
+                                         tape.element(element)};
+            if (run_query(program, attributes))
+                matches[i].push_back(element);
+        }
+    }
+    for (size_t i = 0; i < plan.size(); i++) {
+        if (matches[i].empty())
+            continue;
+        out << "Query: " << plan.name(i) << "\n";
+        for (uint32_t element : matches[i])
+            tape.print(element, out, only_print);
     }
 }
 
-void find_node_by_text(const XMLElement *element, const std::string &text_value,
-                       const char *only_print,
-                       const std::string &filter_attribute = "",
-                       const std::string &filter_value = "") {
-    const char *text_attr = element->Attribute("text");
-    if (text_attr && text_value == text_attr) {
-        if (node_matches_additional_filter(element, filter_attribute,
-                                           filter_value)) {
-            print_node_attributes(element, only_print);
+// Receives each dump of a batch run: its name, its bytes, the worker
+// running it and the stream its output goes to.
+typedef std::function<void(const std::string &, const char *, size_t,
+                           unsigned, std::ostream &)>
+    DocumentHandler;
+
+// Hands every dump inside an archive to handle, in archive order. Zip
+// entries are extracted by the workers themselves; a tar stream can only
+// be read in order, so a window of entries is read ahead and then
+// searched in parallel.
+bool search_archive(const std::string &path, ArchiveKind kind, unsigned jobs,
+                    const DocumentHandler &handle, std::ostream &results,
+                    ProgressReporter *progress, size_t &documents) {
+    OrderedQueue *queue = progress ? &progress->queue() : nullptr;
+    std::string error;
+    dprint("Opening archive: %s\n", path.c_str());
+
+    if (kind == ARCHIVE_ZIP) {
+        ZipReader zip;
+        if (!zip.open(path, error)) {
+            std::cerr << "Error: " << error << "\n";
+            return false;
         }
+        dprint("Archive holds %zu dump(s)\n", zip.size());
+
+        std::vector<ArchiveBuffer> buffers(jobs);
+        std::atomic<bool> failed(false);
+        run_ordered(
+            zip.size(), jobs,
+            [&](size_t i, unsigned worker, std::ostream &out) {
+                std::string error;
+                uint64_t started = progress ? now_ns() : 0;
+                if (!zip.extract(i, buffers[worker], error)) {
+                    std::cerr << "Error: " << path << ": " << error << "\n";
+                    failed = true;
+                    return;
+                }
+                if (progress) {
+                    WorkerCounters::add(progress->worker(worker).read_ns,
+                                        now_ns() - started);
+                }
+                handle(path + ":" + zip.name(i), buffers[worker].data(),
+                       buffers[worker].size(), worker, out);
+            },
+            results, nullptr, queue);
+        documents += zip.size();
+        return !failed;
     }
 
-    for (const XMLElement *child = element->FirstChildElement();
-         child != nullptr; child = child->NextSiblingElement()) {
-        find_node_by_text(child, text_value, only_print, filter_attribute,
-                          filter_value);
+    TarReader tar;
+    if (!tar.open(path, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return false;
     }
-}
 
-void find_node_by_filter(const XMLElement *element,
-                         const std::string &filter_attribute,
-                         const std::string &filter_value,
-                         const char *only_print) {
-    for (const XMLElement *child = element; child != nullptr;
-         child = child->NextSiblingElement()) {
-        if (node_matches_additional_filter(child, filter_attribute,
-                                           filter_value)) {
-            print_node_attributes(child, only_print);
+    size_t window = (size_t)jobs * 8;
+    std::vector<ArchiveBuffer> buffers(window);
+    std::vector<std::string> names(window);
+    size_t read;
+    do {
+        read = 0;
+        uint64_t started = progress ? now_ns() : 0;
+        while (read < window && tar.next(names[read], buffers[read], error))
+            read++;
+        if (progress) {
+            WorkerCounters::add(progress->main_thread().read_ns,
+                                now_ns() - started);
         }
-        find_node_by_filter(child->FirstChildElement(), filter_attribute,
-                            filter_value, only_print);
+        run_ordered(
+            read, jobs,
+            [&](size_t i, unsigned worker, std::ostream &out) {
+                handle(path + ":" + names[i], buffers[i].data(),
+                       buffers[i].size(), worker, out);
+            },
+            results, nullptr, queue);
+        documents += read;
+    } while (read == window);
+
+    if (!error.empty()) {
+        std::cerr << "Error: " << path << ": " << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+void report_alloc_stats() {
+    print_alloc_stats(std::cerr, alloc_stats());
+}
+
+// Prints what the partial outputs at paths add up to and writes their
+// index entries into place.
+int merge_outputs(const std::vector<std::string> &paths) {
+    PartialTotals totals;
+    std::string error;
+    if (!merge_partials(paths, std::cout, totals, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
     }
+    if (totals.has_lint)
+        totals.lint.print(std::cout, debug ? 10 : 3);
+    bool ok = true;
+    for (const auto &index : totals.index)
+        ok &= update_index(index.first, index.second);
+    return ok ? 0 : 1;
+}
+
+bool compile_query_option(const char *option, const std::string &text,
+                          Query &query) {
+    std::string error;
+    if (!query.compile(text, error)) {
+        std::cerr << "Error: " << option << ": " << error << "\n";
+        return false;
+    }
+    if (debug) {
+        std::cout << "Compiled " << option << " '" << text << "':\n";
+        query.disassemble(std::cout);
+    }
+    return true;
 }
 
 int main(int argc, char **argv) {
-    std::string xml_file;
+    std::vector<std::string> xml_paths, xml_files;
     std::string filter_attribute, filter_value, only_print;
-    std::string resource_id, class_name, text_value;
+    std::string resource_id, class_name, text_value, query_text;
+    std::string query_file, plan_cache;
+    bool use_prefilter = true, build_index = false;
+    unsigned jobs = default_jobs();
+    ShardSpec shard;
+    bool sharded = false, merge = false;
+    std::string checkpoint_path;
+    bool resume = false;
+    bool show_progress = false;
+    std::string progress_json_path;
+    bool show_alloc_stats = false, alloc_test = false;
+    std::string replay_query_file;
+    bool scaling_bench = false;
+    std::string nearest_query, target_query, stitch_query;
+    std::string library_file;
+    double min_coverage = DEFAULT_MIN_COVERAGE;
+    bool lint = false, text_dump = false;
+    std::string grid_query, grid_cells_query;
+    std::vector<std::string> grid_columns;
+    LintOptions lint_options;
+    OrderKey order_key;
+    size_t top_count = (size_t)-1;
+    size_t nearest_k = 1;
+    Direction direction = DIRECTION_ANY;
 
     static struct option long_options[] = {
         {"file", required_argument, 0, 'f'},
@@ -194,17 +593,50 @@ int main(int argc, char **argv) {
         {"class", required_argument, 0, 'c'},
         {"text", required_argument, 0, 't'},
         {"filter-attribute", required_argument, 0, 'F'},
+        {"query", required_argument, 0, 'q'},
+        {"query-file", required_argument, 0, OPT_QUERY_FILE},
+        {"plan-cache", required_argument, 0, OPT_PLAN_CACHE},
         {"print-only", required_argument, 0, 'p'},
+        {"order-by", required_argument, 0, OPT_ORDER_BY},
+        {"top", required_argument, 0, OPT_TOP},
+        {"nearest", required_argument, 0, OPT_NEAREST},
+        {"target", required_argument, 0, OPT_TARGET},
+        {"k", required_argument, 0, OPT_K},
+        {"direction", required_argument, 0, OPT_DIRECTION},
+        {"stitch", required_argument, 0, OPT_STITCH},
+        {"identify", required_argument, 0, OPT_IDENTIFY},
+        {"min-coverage", required_argument, 0, OPT_MIN_COVERAGE},
+        {"lint", no_argument, 0, OPT_LINT},
+        {"min-target-size", required_argument, 0, OPT_MIN_TARGET_SIZE},
+        {"text-dump", no_argument, 0, OPT_TEXT_DUMP},
+        {"grid", required_argument, 0, OPT_GRID},
+        {"grid-cells", required_argument, 0, OPT_GRID_CELLS},
+        {"columns", required_argument, 0, OPT_COLUMNS},
+        {"no-prefilter", no_argument, 0, OPT_NO_PREFILTER},
+        {"build-index", no_argument, 0, OPT_BUILD_INDEX},
+        {"jobs", required_argument, 0, 'j'},
+        {"shard", required_argument, 0, OPT_SHARD},
+        {"merge", no_argument, 0, OPT_MERGE},
+        {"checkpoint", required_argument, 0, OPT_CHECKPOINT},
+        {"resume", no_argument, 0, OPT_RESUME},
+        {"progress", no_argument, 0, OPT_PROGRESS},
+        {"progress-json", required_argument, 0, OPT_PROGRESS_JSON},
+        {"alloc-stats", no_argument, 0, OPT_ALLOC_STATS},
+        {"alloc-test", no_argument, 0, OPT_ALLOC_TEST},
+        {"replay-bench", required_argument, 0, OPT_REPLAY_BENCH},
+        {"scaling-bench", no_argument, 0, OPT_SCALING_BENCH},
+        {"self-bench", no_argument, 0, OPT_SELF_BENCH},
+        {"diff-test", required_argument, 0, OPT_DIFF_TEST},
         {"debug", no_argument, 0, 'd'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}};
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "f:r:c:t:F:p:dh", long_options,
+    while ((opt = getopt_long(argc, argv, "f:r:c:t:F:q:p:j:dh", long_options,
                               NULL)) != -1) {
         switch (opt) {
         case 'f':
-            xml_file = optarg;
+            xml_paths.push_back(optarg);
             break;
         case 'r':
             resource_id = optarg;
@@ -224,9 +656,127 @@ int main(int argc, char **argv) {
             }
             break;
         }
+        case 'q':
+            query_text = optarg;
+            break;
+        case OPT_QUERY_FILE:
+            query_file = optarg;
+            break;
+        case OPT_PLAN_CACHE:
+            plan_cache = optarg;
+            break;
         case 'p':
             only_print = optarg;
             break;
+        case OPT_ORDER_BY:
+            if (!parse_order_key(optarg, order_key)) {
+                std::cerr << "Error: --order-by needs a key\n";
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_TOP:
+            top_count = strtoul(optarg, NULL, 10);
+            break;
+        case OPT_NEAREST:
+            nearest_query = optarg;
+            break;
+        case OPT_TARGET:
+            target_query = optarg;
+            break;
+        case OPT_K:
+            nearest_k = strtoul(optarg, NULL, 10);
+            break;
+        case OPT_DIRECTION:
+            if (!parse_direction(optarg, direction)) {
+                std::cerr << "Error: unknown direction '" << optarg
+                          << "'. Use right-of, left-of, below or above.\n";
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_STITCH:
+            stitch_query = optarg;
+            break;
+        case OPT_IDENTIFY:
+            library_file = optarg;
+            break;
+        case OPT_MIN_COVERAGE:
+            min_coverage = strtod(optarg, NULL);
+            break;
+        case OPT_LINT:
+            lint = true;
+            break;
+        case OPT_MIN_TARGET_SIZE:
+            lint_options.min_target_size = atoi(optarg);
+            break;
+        case OPT_TEXT_DUMP:
+            text_dump = true;
+            break;
+        case OPT_GRID:
+            grid_query = optarg;
+            break;
+        case OPT_GRID_CELLS:
+            grid_cells_query = optarg;
+            break;
+        case OPT_COLUMNS: {
+            std::string columns(optarg);
+            size_t start = 0, comma;
+            while ((comma = columns.find(',', start)) != std::string::npos) {
+                grid_columns.push_back(columns.substr(start, comma - start));
+                start = comma + 1;
+            }
+            grid_columns.push_back(columns.substr(start));
+            break;
+        }
+        case OPT_NO_PREFILTER:
+            use_prefilter = false;
+            break;
+        case OPT_BUILD_INDEX:
+            build_index = true;
+            break;
+        case 'j':
+            jobs = strtoul(optarg, NULL, 10);
+            if (jobs == 0)
+                jobs = 1;
+            break;
+        case OPT_SHARD:
+            if (!parse_shard_spec(optarg, shard)) {
+                std::cerr << "Error: --shard needs i/N with 1 <= i <= N\n";
+                exit(EXIT_FAILURE);
+            }
+            sharded = true;
+            break;
+        case OPT_MERGE:
+            merge = true;
+            break;
+        case OPT_CHECKPOINT:
+            checkpoint_path = optarg;
+            break;
+        case OPT_RESUME:
+            resume = true;
+            break;
+        case OPT_PROGRESS:
+            show_progress = true;
+            break;
+        case OPT_PROGRESS_JSON:
+            progress_json_path = optarg;
+            break;
+        case OPT_ALLOC_STATS:
+            show_alloc_stats = true;
+            break;
+        case OPT_ALLOC_TEST:
+            alloc_test = true;
+            break;
+        case OPT_REPLAY_BENCH:
+            replay_query_file = optarg;
+            break;
+        case OPT_SCALING_BENCH:
+            scaling_bench = true;
+            break;
+        case OPT_SELF_BENCH:
+            self_benchmark(std::cout);
+            return 0;
+        case OPT_DIFF_TEST:
+            return differential_test(strtoul(optarg, NULL, 10), std::cout);
         case 'd':
             debug = 1;
             break;
@@ -244,39 +794,564 @@ int main(int argc, char **argv) {
         }
     }
 
-    if (xml_file.empty()) {
+    for (int i = optind; i < argc; i++)
+        xml_paths.push_back(argv[i]);
+
+    if (show_alloc_stats || alloc_test || scaling_bench)
+        start_alloc_stats();
+    if (show_alloc_stats)
+        atexit(report_alloc_stats);
+
+    if (merge)
+        return merge_outputs(xml_paths);
+
+    if (scaling_bench && (sharded || !checkpoint_path.empty())) {
+        std::cerr << "Error: --scaling-bench runs the whole search in "
+                     "memory, without --shard or --checkpoint\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (resume && checkpoint_path.empty()) {
+        std::cerr << "Error: --resume needs --checkpoint <file>\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (!expand_inputs(xml_paths, xml_files))
+        exit(EXIT_FAILURE);
+
+    if (xml_files.empty()) {
         std::cerr << "Error: XML file is required. Use --file <xml_file>\n";
         exit(EXIT_FAILURE);
     }
 
-    dprint("Opening XML file: %s\n", xml_file.c_str());
+    if (!replay_query_file.empty())
+        return replay_benchmark(xml_files, replay_query_file, std::cout);
 
-    XMLDocument doc;
-    if (doc.LoadFile(xml_file.c_str()) != XML_SUCCESS) {
-        std::cerr << "Error: could not parse file " << xml_file << "\n";
-        return 1;
+    if (sharded) {
+        if (!stitch_query.empty()) {
+            std::cerr << "Error: --stitch needs every file in one run\n";
+            exit(EXIT_FAILURE);
+        }
+        select_shard(shard, xml_files);
+        dprint("Shard %u/%u: %zu input(s)\n", shard.index, shard.count,
+               xml_files.size());
+    }
+
+    if (build_index) {
+        dprint("Indexing %zu file(s) with %u job(s)\n", xml_files.size(),
+               jobs);
+        if (!sharded)
+            return build_indexes(xml_files, jobs) ? 0 : 1;
+        IndexShards shards;
+        bool ok = index_files(xml_files, jobs, shards);
+        PartialWriter partial(std::cout);
+        partial.begin(shard);
+        partial.add_index(shards);
+        return partial.finish() && ok ? 0 : 1;
+    }
+
+    Query query, nearest, target, stitch, grid;
+    if ((!query_text.empty() &&
+         !compile_query_option("--query", query_text, query)) ||
+        (!nearest_query.empty() &&
+         (!compile_query_option("--nearest", nearest_query, nearest) ||
+          !compile_query_option("--target", target_query, target))) ||
+        (!stitch_query.empty() &&
+         !compile_query_option("--stitch", stitch_query, stitch)) ||
+        (!grid_query.empty() &&
+         !compile_query_option("--grid", grid_query, grid)) ||
+        (!grid_cells_query.empty() &&
+         !compile_query_option("--grid-cells", grid_cells_query, grid))) {
+        exit(EXIT_FAILURE);
+    }
+
+    QueryPlan plan;
+    if (!query_file.empty()) {
+        std::string error;
+        if (!plan.load(query_file, plan_cache, error)) {
+            std::cerr << "Error: " << error << "\n";
+            exit(EXIT_FAILURE);
+        }
+        dprint("Loaded %zu queries from %s\n", plan.size(),
+               plan.cached() ? "the plan cache" : query_file.c_str());
+    }
+
+    if (!stitch_query.empty()) {
+        return stitch_lists(xml_files, stitch.program(), only_print.c_str());
     }
 
-    dprint("Successfully loaded XML file\n");
+    ScreenLibrary library;
+    if (!library_file.empty()) {
+        std::string error;
+        if (!library.load(library_file.c_str(), error)) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        dprint("Loaded %zu screen signature(s)\n", library.size());
+    }
 
-    const XMLElement *root_element = doc.RootElement();
+    if (grid_columns.empty())
+        grid_columns.push_back("text");
 
-    if (!resource_id.empty()) {
-        find_node_by_resource_id(root_element, resource_id, only_print.c_str(),
-                                 filter_attribute, filter_value);
-    } else if (!class_name.empty()) {
-        find_node_by_class(root_element, class_name, only_print.c_str(),
-                           filter_attribute, filter_value);
-    } else if (!text_value.empty()) {
-        find_node_by_text(root_element, text_value, only_print.c_str(),
-                          filter_attribute, filter_value);
-    } else if (!filter_attribute.empty() && !filter_value.empty()) {
-        find_node_by_filter(root_element, filter_attribute, filter_value,
-                            only_print.c_str());
-    } else {
+    // Plain searches on exact values can rule files out from their raw
+    // bytes; the other modes look at every node and need the parse.
+    Prefilter prefilter;
+    bool plain_search = grid_query.empty() && grid_cells_query.empty() &&
+                        !text_dump && !lint && library_file.empty() &&
+                        nearest_query.empty() && query_file.empty();
+    if (use_prefilter && plain_search) {
+        std::vector<QueryTerm> required;
+        if (!query_text.empty()) {
+            query.required_terms(required);
+        } else if (!resource_id.empty()) {
+            required.push_back(QueryTerm{"resource-id", resource_id, true});
+        } else if (!class_name.empty()) {
+            required.push_back(QueryTerm{"class", class_name, true});
+        } else if (!text_value.empty()) {
+            required.push_back(QueryTerm{"text", text_value, true});
+        }
+        if (!filter_attribute.empty() && !filter_value.empty())
+            required.push_back(QueryTerm{filter_attribute, filter_value, true});
+        for (const QueryTerm &term : required)
+            prefilter.require(term);
+    }
+    // A query file rules a file out when it rules out every query; a query
+    // without required terms can match anything.
+    if (use_prefilter && !query_file.empty() && grid_query.empty() &&
+        grid_cells_query.empty() && !text_dump && !lint &&
+        library_file.empty() && nearest_query.empty()) {
+        std::vector<std::vector<QueryTerm>> alternatives(plan.size());
+        bool bounded = plan.size() > 0;
+        for (size_t i = 0; i < plan.size(); i++) {
+            plan.required_terms(i, alternatives[i]);
+            bounded = bounded && !alternatives[i].empty();
+        }
+        for (size_t i = 0; bounded && i < plan.size(); i++) {
+            if (i)
+                prefilter.alternative();
+            if (!filter_attribute.empty() && !filter_value.empty())
+                alternatives[i].push_back(
+                    QueryTerm{filter_attribute, filter_value, true});
+            for (const QueryTerm &term : alternatives[i])
+                prefilter.require(term);
+        }
+    }
+    // The query and class searches compare attributes with few distinct
+    // values by pointer, in documents that intern those values.
+    bool intern_values =
+        plain_search &&
+        (!query_text.empty()
+             ? query_tests_equality(query.program(),
+                                    LOW_CARDINALITY_ATTRIBUTES)
+             : resource_id.empty() && !class_name.empty());
+    bool searching = !query_text.empty() || !resource_id.empty() ||
+                     !class_name.empty() || !text_value.empty() ||
+                     (!filter_attribute.empty() && !filter_value.empty());
+    if (plain_search && !searching) {
         std::cerr << "No search criteria specified. Use --resource-id, "
-                     "--class, --text, or --filter-attribute <attr=value>.\n";
+                     "--class, --text, --query or --filter-attribute "
+                     "<attr=value>.\n";
+        return 0;
     }
 
-    return 0;
+    // A shard writes everything it produces as one partial output, for
+    // --merge to put back together. A checkpointed run writes the same
+    // format to its checkpoint file and prints it once it is done.
+    std::unique_ptr<Checkpoint> checkpoint;
+    std::unique_ptr<PartialWriter> partial;
+    if (!checkpoint_path.empty()) {
+        std::string error;
+        checkpoint.reset(new Checkpoint());
+        if (!checkpoint->open(checkpoint_path, shard, xml_files, resume,
+                              error)) {
+            std::cerr << "Error: " << error << "\n";
+            return 1;
+        }
+        dprint("Resuming after %zu of %zu input(s)\n",
+               checkpoint->complete() ? xml_files.size()
+                                      : checkpoint->completed(),
+               xml_files.size());
+    } else if (sharded) {
+        partial.reset(new PartialWriter(std::cout));
+        partial->begin(shard);
+    }
+    PartialWriter *writer =
+        checkpoint ? &checkpoint->partial() : partial.get();
+    std::ostream &results = writer ? writer->output() : std::cout;
+
+    // Documents are searched on several workers. Each worker keeps its own
+    // ranking, lint totals and screen library scratch space, and prints to
+    // a stream that run_ordered hands back in input order.
+    bool ranked = order_key.field != ORDER_DOCUMENT || top_count != (size_t)-1;
+    // Query searches that print every match as they find it run over a
+    // tape, which parses faster than the DOM; dumps the tape does not
+    // cover are parsed into a DOM as before.
+    bool filtered = !filter_attribute.empty() && !filter_value.empty();
+    bool tape_search =
+        !ranked && !filtered && grid_query.empty() &&
+        grid_cells_query.empty() && !text_dump && !lint &&
+        library_file.empty() && nearest_query.empty() &&
+        (!query_file.empty() || !query_text.empty());
+    std::vector<TopK> tops(jobs, TopK(order_key, top_count));
+    std::vector<LintSummary> lint_summaries(jobs);
+    std::vector<ScreenScratch> library_scratch(jobs);
+    bool show_names = sharded || xml_files.size() > 1 ||
+                      archive_kind(xml_files[0]) != ARCHIVE_NONE;
+    std::atomic<size_t> prefiltered(0);
+    std::atomic<int> status(0);
+
+    std::unique_ptr<ProgressReporter> progress;
+    FILE *progress_json = nullptr;
+    if (!progress_json_path.empty()) {
+        progress_json = fopen(progress_json_path.c_str(), "a");
+        if (!progress_json) {
+            std::cerr << "Error: could not open " << progress_json_path
+                      << "\n";
+            return 1;
+        }
+    }
+    if (show_progress || progress_json || scaling_bench) {
+        progress.reset(new ProgressReporter(jobs, xml_files.size(),
+                                            show_progress, progress_json));
+    }
+    OrderedQueue *queue = progress ? &progress->queue() : nullptr;
+
+    // Lint totals of the inputs written out so far. Dumps inside archives
+    // add to their worker's summary, as an archive is done before the next
+    // input starts; plain files, whose workers run ahead of the output,
+    // add theirs here once written out.
+    LintSummary lint_written;
+    if (checkpoint)
+        lint_written = checkpoint->lint();
+    std::vector<LintSummary *> lint_targets(jobs);
+    for (unsigned worker = 0; worker < jobs; worker++)
+        lint_targets[worker] = &lint_summaries[worker];
+
+    // Called on the thread writing the output, once the first completed
+    // inputs are written out.
+    auto finished = [&](size_t completed) {
+        if (progress)
+            progress->set_completed(completed);
+        if (!checkpoint || !checkpoint->due())
+            return;
+        LintSummary lint = lint_written;
+        for (const LintSummary &summary : lint_summaries)
+            lint.merge(summary);
+        checkpoint->save(completed, std::move(lint));
+        dprint("Checkpoint after %zu input(s)\n", completed);
+    };
+
+    // Scratch space per worker, reused so that a warm worker searching a
+    // parsed tree does not touch the heap.
+    std::vector<PlanMatches> plan_matches(jobs);
+    std::vector<std::vector<const XMLElement *>> ordered(jobs);
+    std::vector<QueryInterner> interners(jobs);
+    std::vector<Tape> tapes(jobs);
+    std::vector<std::vector<std::vector<uint32_t>>> tape_matches(jobs);
+
+    auto search_tree = [&](XMLDocument &doc, unsigned worker,
+                           std::ostream &out) {
+        const XMLElement *root_element = doc.RootElement();
+        top_matches = ranked ? &tops[worker] : nullptr;
+
+        if (!grid_query.empty()) {
+            find_grids(out, root_element, grid.program(), grid_columns);
+        } else if (!grid_cells_query.empty()) {
+            std::vector<const XMLElement *> matches;
+            collect_matching(root_element, grid.program(), matches);
+            print_grid_of(out, matches, grid_columns);
+        } else if (text_dump) {
+            print_text_dump(root_element, out);
+        } else if (lint) {
+            std::vector<LintFinding> findings;
+            lint_tree(root_element, lint_options, findings);
+            for (const LintFinding &finding : findings)
+                print_lint_finding(out, finding);
+            lint_targets[worker]->add(findings);
+        } else if (!library_file.empty()) {
+            identify_screen(out, library, min_coverage,
+                            library_scratch[worker], root_element);
+        } else if (!nearest_query.empty()) {
+            find_nearest_nodes(out, root_element, nearest.program(),
+                               target.program(), nearest_k, direction,
+                               only_print.c_str());
+        } else if (!query_file.empty()) {
+            find_nodes_by_plan(out, root_element, plan, only_print.c_str(),
+                               filter_attribute, filter_value,
+                               plan_matches[worker], ordered[worker]);
+        } else if (!query_text.empty()) {
+            QueryProgram program = query.program();
+            const QueryInterning *interning =
+                intern_values ? interners[worker].resolve(program, doc)
+                              : nullptr;
+            find_node_by_query(out, root_element, program,
+                               only_print.c_str(), filter_attribute,
+                               filter_value, interning);
+        } else if (!resource_id.empty()) {
+            find_node_by_resource_id(out, root_element, resource_id,
+                                     only_print.c_str(), filter_attribute,
+                                     filter_value);
+        } else if (!class_name.empty()) {
+            find_node_by_class(out, root_element, class_name,
+                               only_print.c_str(), filter_attribute,
+                               filter_value,
+                               intern_values
+                                   ? doc.InternValue(class_name.c_str())
+                                   : nullptr);
+        } else if (!text_value.empty()) {
+            find_node_by_text(out, root_element, text_value,
+                              only_print.c_str(), filter_attribute,
+                              filter_value);
+        } else {
+            find_node_by_filter(out, root_element, filter_attribute,
+                                filter_value, only_print.c_str());
+        }
+
+        if (top_matches) {
+            top_matches->take(ordered[worker]);
+            for (const XMLElement *element : ordered[worker])
+                print_node_attributes(out, element, only_print.c_str());
+        }
+    };
+
+    auto search_tape = [&](unsigned worker, std::ostream &out) {
+        if (!query_file.empty()) {
+            find_nodes_by_plan(out, tapes[worker], plan, only_print.c_str(),
+                               tape_matches[worker]);
+        } else {
+            find_node_by_query(out, tapes[worker], query.program(),
+                               only_print.c_str());
+        }
+    };
+
+    auto search_document = [&](const std::string &name, const char *data,
+                               size_t size, unsigned worker,
+                               std::ostream &out) {
+        if (tape_search && tapes[worker].parse(data, size)) {
+            dprint("Successfully loaded XML file onto a tape\n");
+            search_tape(worker, out);
+            return;
+        }
+
+        XMLDocument doc;
+        doc.SetLazyAttributes(true);
+        if (intern_values)
+            doc.SetInternedAttributes(LOW_CARDINALITY_ATTRIBUTES);
+        if (doc.Parse(data, size) != XML_SUCCESS) {
+            std::cerr << "Error: could not parse file " << name << "\n";
+            status = 1;
+            return;
+        }
+
+        dprint("Successfully loaded XML file\n");
+        search_tree(doc, worker, out);
+    };
+
+    if (alloc_test) {
+        MappedFile input;
+        XMLDocument doc;
+        doc.SetLazyAttributes(true);
+        if (intern_values)
+            doc.SetInternedAttributes(LOW_CARDINALITY_ATTRIBUTES);
+        if (!input.open(xml_files[0].c_str()) ||
+            doc.Parse(input.data(), input.size()) != XML_SUCCESS) {
+            std::cerr << "Error: could not parse file " << xml_files[0]
+                      << "\n";
+            return 1;
+        }
+        // A search the tape takes parses the file again every time, as
+        // each input of a batch would be.
+        bool on_tape =
+            tape_search && tapes[0].parse(input.data(), input.size());
+        std::ostream discard(nullptr);
+        uint64_t allocations = steady_state_allocations(
+            [&]() {
+                if (on_tape) {
+                    tapes[0].parse(input.data(), input.size());
+                    search_tape(0, discard);
+                } else {
+                    search_tree(doc, 0, discard);
+                }
+            },
+            ALLOC_TEST_WARMUP, ALLOC_TEST_ITERATIONS);
+        std::cout << "Allocation test: " << allocations
+                  << " allocation(s) in " << ALLOC_TEST_ITERATIONS
+                  << " searches after warmup: "
+                  << (allocations ? "FAILED" : "passed") << "\n";
+        return allocations ? 1 : 0;
+    }
+
+    DocumentHandler search = [&](const std::string &name, const char *data,
+                                 size_t size, unsigned worker,
+                                 std::ostream &out) {
+        uint64_t started = progress ? now_ns() : 0;
+        if (show_names)
+            out << "File: " << name << "\n";
+
+        bool skip = !prefilter.empty() && !prefilter.may_match(data, size);
+        if (progress) {
+            WorkerCounters &counters = progress->worker(worker);
+            uint64_t now = now_ns();
+            WorkerCounters::add(counters.files, 1);
+            WorkerCounters::add(counters.bytes, size);
+            WorkerCounters::add(counters.read_ns, now - started);
+            started = now;
+        }
+        if (skip) {
+            dprint("Skipping %s, its bytes cannot match\n", name.c_str());
+            prefiltered++;
+            return;
+        }
+
+        search_document(name, data, size, worker, out);
+        if (progress) {
+            WorkerCounters::add(progress->worker(worker).parse_ns,
+                                now_ns() - started);
+        }
+    };
+
+    auto search_file = [&](const std::string &xml_file, unsigned worker,
+                           std::ostream &out) {
+        dprint("Opening XML file: %s\n", xml_file.c_str());
+
+        if (!prefilter.empty() && !prefilter.may_match_indexed(xml_file)) {
+            dprint("Skipping file, its index rules out a match\n");
+            if (show_names)
+                out << "File: " << xml_file << "\n";
+            prefiltered++;
+            return;
+        }
+
+        uint64_t started = progress ? now_ns() : 0;
+        MappedFile input;
+        if (!input.open(xml_file.c_str())) {
+            std::cerr << "Error: could not parse file " << xml_file << "\n";
+            status = 1;
+            return;
+        }
+        if (progress) {
+            WorkerCounters::add(progress->worker(worker).read_ns,
+                                now_ns() - started);
+        }
+        search(xml_file, input.data(), input.size(), worker, out);
+    };
+
+    // Searches the inputs from first on with the given number of workers.
+    // Runs of plain files go to the workers together; archives are
+    // searched one at a time, their entries spread over the workers.
+    size_t documents = 0;
+    std::vector<LintSummary> item_lint; // per slot of run_ordered
+    auto run_batch = [&](size_t first, unsigned workers, std::ostream &out) {
+        for (size_t i = first; i < xml_files.size();) {
+            ArchiveKind kind = archive_kind(xml_files[i]);
+            if (kind != ARCHIVE_NONE) {
+                if (!search_archive(xml_files[i], kind, workers, search, out,
+                                    progress.get(), documents))
+                    status = 1;
+                i++;
+                finished(i);
+                continue;
+            }
+
+            size_t end = i;
+            while (end < xml_files.size() &&
+                   archive_kind(xml_files[end]) == ARCHIVE_NONE)
+                end++;
+            if (lint)
+                item_lint.resize(ordered_slots(workers));
+            run_ordered(
+                end - i, workers,
+                [&](size_t k, unsigned worker, std::ostream &item_out) {
+                    if (!lint) {
+                        search_file(xml_files[i + k], worker, item_out);
+                        return;
+                    }
+                    LintSummary &summary = item_lint[k % item_lint.size()];
+                    summary = LintSummary();
+                    lint_targets[worker] = &summary;
+                    search_file(xml_files[i + k], worker, item_out);
+                    lint_targets[worker] = &lint_summaries[worker];
+                },
+                out,
+                [&](size_t done) {
+                    if (lint)
+                        lint_written.merge(item_lint[(done - 1) %
+                                                     item_lint.size()]);
+                    finished(i + done);
+                },
+                queue);
+            documents += end - i;
+            i = end;
+        }
+    };
+
+    // The same workload at 1, 2, 4 ... jobs threads, after one untimed
+    // run that warms the page cache and the allocator up.
+    if (scaling_bench) {
+        std::ostream discard(nullptr);
+        run_batch(0, jobs, discard);
+        std::vector<ScalingRun> runs;
+        for (unsigned workers : scaling_steps(jobs)) {
+            ScalingSample before = ScalingSample::take(*progress, jobs);
+            uint64_t started = now_ns();
+            run_batch(0, workers, discard);
+            ScalingRun run = {workers, now_ns() - started,
+                              ScalingSample::take(*progress, jobs) - before};
+            runs.push_back(run);
+        }
+        print_scaling(std::cout, runs);
+        return status;
+    }
+
+    size_t first = 0;
+    if (checkpoint)
+        first = checkpoint->complete() ? xml_files.size()
+                                       : checkpoint->completed();
+    if (progress) {
+        progress->set_completed(first);
+        progress->start();
+    }
+    run_batch(first, jobs, results);
+
+    if (progress)
+        progress->stop();
+    if (progress_json)
+        fclose(progress_json);
+
+    if (!prefilter.empty())
+        dprint("Prefilter skipped %zu of %zu file(s)\n", prefiltered.load(),
+               documents);
+    if (size_t stale = prefilter.stale_index_entries()) {
+        std::cerr << "Warning: " << stale << " file(s) changed since they "
+                  << "were indexed; run --build-index to refresh them\n";
+    }
+
+    if (lint) {
+        for (const LintSummary &summary : lint_summaries)
+            lint_written.merge(summary);
+        if (partial)
+            partial->add_lint(lint_written);
+        else if (!checkpoint && documents > 1)
+            lint_written.print(std::cout, debug ? 10 : 3);
+    }
+
+    if (checkpoint) {
+        if (!checkpoint->complete() &&
+            !checkpoint->finish(lint ? &lint_written : nullptr)) {
+            std::cerr << "Error: could not write " << checkpoint_path << "\n";
+            return 1;
+        }
+        checkpoint->close();
+        if (sharded) {
+            std::ifstream saved(checkpoint_path, std::ios::binary);
+            std::cout << saved.rdbuf();
+        } else if (merge_outputs(std::vector<std::string>(
+                       1, checkpoint_path)) != 0) {
+            status = 1;
+        }
+    } else if (partial && !partial->finish()) {
+        std::cerr << "Error: could not write the partial output\n";
+        status = 1;
+    }
+    return status;
 }
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memmem.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+static const char *find_bytes_scalar(const char *haystack, size_t length,
+                                     const char *needle,
+                                     size_t needle_length) {
+    const char *last = haystack + length - needle_length;
+    for (const char *p = haystack; p <= last; p++) {
+        p = (const char *)memchr(p, needle[0], last - p + 1);
+        if (!p)
+            return nullptr;
+        if (memcmp(p + 1, needle + 1, needle_length - 1) == 0)
+            return p;
+    }
+    return nullptr;
+}
+
+#if defined(__SSE2__)
+
+static uint32_t candidates(const char *p, size_t last_offset,
+                           __m128i first, __m128i last) {
+    __m128i block_first = _mm_loadu_si128((const __m128i *)p);
+    __m128i block_last = _mm_loadu_si128((const __m128i *)(p + last_offset));
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                               _mm_cmpeq_epi8(block_last, last));
+    return _mm_movemask_epi8(eq);
+}
+
+#define HAVE_SIMD_CANDIDATES 1
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static uint32_t candidates(const char *p, size_t last_offset, uint8x16_t first,
+                           uint8x16_t last) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                        1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t eq =
+        vandq_u8(vceqq_u8(vld1q_u8((const uint8_t *)p), first),
+                 vceqq_u8(vld1q_u8((const uint8_t *)(p + last_offset)), last));
+    // NEON has no movemask: weight each lane by its bit and add pairwise
+    // down to one byte per half.
+    uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+    uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    return vget_lane_u8(sum, 0) | ((uint32_t)vget_lane_u8(sum, 1) << 8);
+}
+
+#define HAVE_SIMD_CANDIDATES 1
+
+#endif
+
+const char *find_bytes(const char *haystack, size_t length, const char *needle,
+                       size_t needle_length) {
+    if (needle_length == 0)
+        return haystack;
+    if (needle_length > length)
+        return nullptr;
+    if (needle_length == 1)
+        return (const char *)memchr(haystack, needle[0], length);
+
+#ifdef HAVE_SIMD_CANDIDATES
+    size_t last_offset = needle_length - 1;
+#if defined(__SSE2__)
+    __m128i first = _mm_set1_epi8(needle[0]);
+    __m128i last = _mm_set1_epi8(needle[last_offset]);
+#else
+    uint8x16_t first = vdupq_n_u8((uint8_t)needle[0]);
+    uint8x16_t last = vdupq_n_u8((uint8_t)needle[last_offset]);
+#endif
+
+    // Positions i..i+15 are candidates; both loads stay inside the
+    // haystack as long as i + last_offset + 16 <= length.
+    size_t i = 0;
+    for (; i + last_offset + 16 <= length; i += 16) {
+        uint32_t mask = candidates(haystack + i, last_offset, first, last);
+        while (mask) {
+            unsigned bit = __builtin_ctz(mask);
+            if (memcmp(haystack + i + bit + 1, needle + 1,
+                       needle_length - 2) == 0)
+                return haystack + i + bit;
+            mask &= mask - 1;
+        }
+    }
+    return find_bytes_scalar(haystack + i, length - i, needle, needle_length);
+#else
+    return find_bytes_scalar(haystack, length, needle, needle_length);
+#endif
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_MEMMEM_H
+#define UIDUMP_MEMMEM_H
+
+#include <cstddef>
+
+// Finds needle in haystack, returning its first occurrence or null.
+//
+// With SSE2 or NEON, 16 candidate positions are tested at once by
+// comparing the needle's first and last bytes against two shifted loads
+// of the haystack; only positions where both agree are verified with
+// memcmp. Without SIMD it falls back to a memchr-driven scan.
+const char *find_bytes(const char *haystack, size_t length, const char *needle,
+                       size_t needle_length);
+
+#endif // UIDUMP_MEMMEM_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "order.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "bounds.h"
+
+using namespace tinyxml2;
+
+bool parse_order_key(const char *text, OrderKey &out) {
+    out.descending = *text == '-';
+    if (out.descending)
+        text++;
+    if (!*text)
+        return false;
+
+    if (strcmp(text, "area") == 0) {
+        out.field = ORDER_AREA;
+    } else if (strcmp(text, "x") == 0) {
+        out.field = ORDER_X;
+    } else if (strcmp(text, "y") == 0) {
+        out.field = ORDER_Y;
+    } else {
+        out.field = ORDER_ATTRIBUTE;
+        out.attribute = text;
+    }
+    return true;
+}
+
+static bool parse_integer(const char *text, long long &out) {
+    if (!*text)
+        return false;
+    char *end;
+    errno = 0;
+    out = strtoll(text, &end, 10);
+    return *end == '\0' && errno == 0;
+}
+
+TopK::TopK(const OrderKey &key, size_t k) : key_(key), k_(k) {
+    heap_.reserve(k < 1024 ? k + 1 : 1024);
+}
+
+bool TopK::ranks_before(const Entry &a, const Entry &b) const {
+    if (key_.field != ORDER_DOCUMENT) {
+        // Numbers rank ahead of text in either direction; only values of
+        // the same kind follow the direction.
+        if (!a.text != !b.text)
+            return !a.text;
+        int order = a.text ? strcmp(a.text, b.text)
+                           : a.number < b.number ? -1 : a.number > b.number;
+        if (order != 0)
+            return key_.descending ? order > 0 : order < 0;
+    }
+    return a.sequence < b.sequence;
+}
+
+void TopK::offer(const XMLElement *element) {
+    Entry entry = {element, nullptr, 0, sequence_++};
+
+    if (key_.field == ORDER_ATTRIBUTE) {
+        const char *value = element->Attribute(key_.attribute.c_str());
+        if (!value)
+            return;
+        if (!parse_integer(value, entry.number))
+            entry.text = value;
+    } else if (key_.field != ORDER_DOCUMENT) {
+        Bounds bounds;
+        if (!element_bounds(element, bounds))
+            return;
+        entry.number = key_.field == ORDER_AREA ? bounds.area()
+                       : key_.field == ORDER_X  ? bounds.left
+                                                : bounds.top;
+    }
+
+    auto worse = [this](const Entry &a, const Entry &b) {
+        return ranks_before(a, b);
+    };
+    if (heap_.size() < k_) {
+        heap_.push_back(entry);
+        std::push_heap(heap_.begin(), heap_.end(), worse);
+    } else if (k_ > 0 && ranks_before(entry, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), worse);
+        heap_.back() = entry;
+        std::push_heap(heap_.begin(), heap_.end(), worse);
+    }
+}
+
+void TopK::take(std::vector<const XMLElement *> &out) {
+    std::sort_heap(heap_.begin(), heap_.end(),
+                   [this](const Entry &a, const Entry &b) {
+                       return ranks_before(a, b);
+                   });
+    out.clear();
+    for (const Entry &entry : heap_)
+        out.push_back(entry.element);
+    heap_.clear();
+    sequence_ = 0;
+}
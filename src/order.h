@@ -0,0 +1,75 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_ORDER_H
+#define UIDUMP_ORDER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "tinyxml2/tinyxml2.h"
+
+enum OrderField {
+    ORDER_DOCUMENT, // keep matches in the order they were found
+    ORDER_ATTRIBUTE,
+    ORDER_AREA,
+    ORDER_X,
+    ORDER_Y,
+};
+
+struct OrderKey {
+    OrderField field = ORDER_DOCUMENT;
+    std::string attribute;
+    bool descending = false;
+};
+
+// Parses "area", "x", "y" or an attribute name; a leading '-' sorts in
+// descending order.
+bool parse_order_key(const char *text, OrderKey &out);
+
+// Keeps the best k nodes offered to it in a bounded heap, so memory stays
+// O(k) however many nodes match. Attribute values that are integers
+// compare numerically and rank ahead of non-numeric ones, in either
+// direction; ties keep document order. Nodes lacking the key are
+// dropped.
+class TopK {
+  public:
+    TopK(const OrderKey &key, size_t k);
+
+    void offer(const tinyxml2::XMLElement *element);
+
+    // Moves the kept nodes into out, best first, and empties the heap.
+    void take(std::vector<const tinyxml2::XMLElement *> &out);
+
+  private:
+    struct Entry {
+        const tinyxml2::XMLElement *element;
+        const char *text; // null when number holds the key
+        long long number;
+        size_t sequence;
+    };
+
+    bool ranks_before(const Entry &a, const Entry &b) const;
+
+    OrderKey key_;
+    size_t k_;
+    size_t sequence_ = 0;
+    std::vector<Entry> heap_; // worst kept entry on top
+};
+
+#endif // UIDUMP_ORDER_H
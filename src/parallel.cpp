@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parallel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "progress.h"
+
+unsigned default_jobs() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+void parallel_for(size_t count, unsigned jobs,
+                  const std::function<void(size_t, unsigned)> &fn) {
+    if (jobs > count)
+        jobs = count;
+    if (jobs <= 1) {
+        for (size_t i = 0; i < count; i++)
+            fn(i, 0);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto work = [&](unsigned worker) {
+        for (;;) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count)
+                return;
+            fn(i, worker);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < jobs; worker++)
+        threads.push_back(std::thread(work, worker));
+    work(0);
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+size_t ordered_slots(unsigned jobs) { return (size_t)jobs * 8; }
+
+void run_ordered(
+    size_t count, unsigned jobs,
+    const std::function<void(size_t, unsigned, std::ostream &)> &fn,
+    std::ostream &out, const std::function<void(size_t)> &done,
+    OrderedQueue *queue) {
+    if (jobs <= 1 || count <= 1) {
+        for (size_t i = 0; i < count; i++) {
+            fn(i, 0, out);
+            if (done)
+                done(i + 1);
+        }
+        return;
+    }
+
+    // Item i runs in slot i % slots once the previous user of that slot
+    // is written out.
+    struct Slot {
+        std::ostringstream out;
+        bool ready = false;
+    };
+    size_t slots = ordered_slots(jobs);
+    if (jobs > count)
+        jobs = count;
+    std::vector<Slot> ring(slots < count ? slots : count);
+    std::mutex lock;
+    std::condition_variable filled, drained;
+    size_t written = 0; // guarded by lock
+    std::atomic<size_t> next(0);
+    if (queue)
+        queue->waiting = count;
+
+    auto work = [&](unsigned worker) {
+        for (;;) {
+            size_t i = next.fetch_add(1, std::memory_order_relaxed);
+            if (i >= count)
+                return;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                drained.wait(guard, [&] { return i < written + slots; });
+            }
+            if (queue)
+                queue->waiting--;
+            Slot &slot = ring[i % slots];
+            fn(i, worker, slot.out);
+
+            std::lock_guard<std::mutex> guard(lock);
+            slot.ready = true;
+            if (queue)
+                queue->buffered++;
+            if (i == written)
+                filled.notify_one();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned worker = 0; worker < jobs; worker++)
+        threads.push_back(std::thread(work, worker));
+
+    // This thread writes out whatever is ready in order while the workers
+    // go on with later items.
+    while (written < count) {
+        size_t end = written;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            filled.wait(guard, [&] { return ring[written % slots].ready; });
+            while (end < count && end < written + slots &&
+                   ring[end % slots].ready)
+                end++;
+        }
+        uint64_t merging = queue ? now_ns() : 0;
+        for (size_t i = written; i < end; i++) {
+            Slot &slot = ring[i % slots];
+            out << slot.out.str();
+            slot.out.str(std::string());
+            if (done)
+                done(i + 1);
+        }
+        if (queue) {
+            queue->merge_ns += now_ns() - merging;
+            queue->buffered -= end - written;
+        }
+
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = written; i < end; i++)
+            ring[i % slots].ready = false;
+        written = end;
+        drained.notify_all();
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+}
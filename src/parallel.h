@@ -0,0 +1,63 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_PARALLEL_H
+#define UIDUMP_PARALLEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// Number of workers to use when the user did not say: one per core.
+unsigned default_jobs();
+
+// Calls fn(index, worker) for every index in [0, count) on up to jobs
+// threads. Workers pull the next index from a shared atomic counter, so
+// uneven items balance themselves. worker is in [0, jobs) and lets fn
+// keep per-thread state without locking.
+void parallel_for(size_t count, unsigned jobs,
+                  const std::function<void(size_t, unsigned)> &fn);
+
+// Live state of a run_ordered run, for progress reports.
+struct OrderedQueue {
+    std::atomic<size_t> waiting;  // items not started yet
+    std::atomic<size_t> buffered; // finished, output held for an earlier one
+    std::atomic<uint64_t> merge_ns; // writing output out, beside the workers
+
+    OrderedQueue() : waiting(0), buffered(0), merge_ns(0) {}
+};
+
+// Most items of a run_ordered run between starting and being written out.
+size_t ordered_slots(unsigned jobs);
+
+// Like parallel_for, but fn also gets a stream for its output, and that
+// output reaches out in index order. The workers live for the whole run;
+// the calling thread writes out finished output in order while they go
+// on with later items, and item i waits for item i - ordered_slots(jobs)
+// to be written out before it starts, so per-item state may live in a
+// ring of that many slots. With a single job fn writes to out directly.
+// When given, done(i + 1) is called on the calling thread once item i is
+// written out, and queue follows the run.
+void run_ordered(
+    size_t count, unsigned jobs,
+    const std::function<void(size_t, unsigned, std::ostream &)> &fn,
+    std::ostream &out, const std::function<void(size_t)> &done = nullptr,
+    OrderedQueue *queue = nullptr);
+
+#endif // UIDUMP_PARALLEL_H
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "partial.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#include "mapped_file.h"
+
+static const char PARTIAL_MAGIC[] = "uidump-partial 1";
+
+bool parse_shard_spec(const char *text, ShardSpec &out) {
+    char *end;
+    unsigned long index = strtoul(text, &end, 10);
+    if (end == text || *end != '/')
+        return false;
+    const char *count_text = end + 1;
+    unsigned long count = strtoul(count_text, &end, 10);
+    if (end == count_text || *end != '\0' || index < 1 || index > count)
+        return false;
+    out.index = index;
+    out.count = count;
+    return true;
+}
+
+void select_shard(const ShardSpec &shard, std::vector<std::string> &inputs) {
+    size_t total = inputs.size();
+    size_t begin = total * (shard.index - 1) / shard.count;
+    size_t end = total * shard.index / shard.count;
+    inputs.erase(inputs.begin() + end, inputs.end());
+    inputs.erase(inputs.begin(), inputs.begin() + begin);
+}
+
+PartialWriter::PartialWriter(std::ostream &out) : out_(out), output_(this) {
+    setp(buffer_, buffer_ + sizeof(buffer_));
+}
+
+void PartialWriter::begin(const ShardSpec &shard) {
+    out_ << PARTIAL_MAGIC << " " << shard.index << " " << shard.count
+         << "\n";
+}
+
+void PartialWriter::write_section(const char *kind, const char *data,
+                                  size_t size) {
+    out_ << kind << " " << size << "\n";
+    out_.write(data, size);
+}
+
+int PartialWriter::overflow(int c) {
+    sync();
+    if (c != traits_type::eof()) {
+        *pptr() = c;
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int PartialWriter::sync() {
+    if (pptr() > pbase())
+        write_section("output", pbase(), pptr() - pbase());
+    setp(buffer_, buffer_ + sizeof(buffer_));
+    return 0;
+}
+
+void PartialWriter::add_lint(const LintSummary &summary) {
+    sync();
+    std::ostringstream text;
+    summary.write(text);
+    std::string data = text.str();
+    write_section("lint", data.data(), data.size());
+}
+
+void PartialWriter::add_section(const char *kind, const std::string &data) {
+    sync();
+    write_section(kind, data.data(), data.size());
+}
+
+void PartialWriter::frame_section(std::string &out, const char *kind,
+                                  const std::string &data) {
+    out += kind;
+    out += " " + std::to_string(data.size()) + "\n";
+    out += data;
+}
+
+void PartialWriter::add_index(const IndexShards &shards) {
+    sync();
+    for (const auto &shard : shards) {
+        std::string data = shard.first + "\n";
+        shard.second.serialize(data);
+        write_section("index", data.data(), data.size());
+    }
+}
+
+bool PartialWriter::finish() {
+    sync();
+    out_ << "end\n";
+    out_.flush();
+    return out_.good();
+}
+
+// Reads "<word> <number>\n".
+bool PartialReader::read_line(std::string &word, size_t &number) {
+    const char *line = data_ + pos_;
+    const char *newline = (const char *)memchr(line, '\n', size_ - pos_);
+    if (!newline)
+        return false;
+    const char *space = (const char *)memchr(line, ' ', newline - line);
+    if (!space)
+        space = newline;
+    word.assign(line, space - line);
+    number = space < newline ? strtoull(space + 1, NULL, 10) : 0;
+    pos_ = newline + 1 - data_;
+    return true;
+}
+
+bool PartialReader::header(ShardSpec &shard) {
+    size_t length = strlen(PARTIAL_MAGIC);
+    const char *newline = (const char *)memchr(data_, '\n', size_);
+    if (!newline || size_ < length ||
+        memcmp(data_, PARTIAL_MAGIC, length) != 0 ||
+        sscanf(std::string(data_ + length, newline).c_str(), "%u %u",
+               &shard.index, &shard.count) != 2)
+        return false;
+    pos_ = newline + 1 - data_;
+    return true;
+}
+
+bool PartialReader::next(std::string &kind, const char *&section,
+                         size_t &length) {
+    size_t start = pos_;
+    if (ended_ || !read_line(kind, length))
+        return false;
+    if (kind == "end") {
+        ended_ = true;
+        return false;
+    }
+    if (length > size_ - pos_) {
+        pos_ = start;
+        return false;
+    }
+    section = data_ + pos_;
+    pos_ += length;
+    return true;
+}
+
+namespace {
+
+struct PartialHeader {
+    std::string path;
+    ShardSpec shard;
+};
+
+bool read_header(const std::string &path, PartialHeader &header) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    char line[64];
+    size_t length = fread(line, 1, sizeof(line), file);
+    fclose(file);
+    header.path = path;
+    return PartialReader(line, length).header(header.shard);
+}
+
+} // namespace
+bool merge_partials(const std::vector<std::string> &paths, std::ostream &out,
+                    PartialTotals &totals, std::string &error) {
+    std::vector<PartialHeader> headers(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!read_header(paths[i], headers[i])) {
+            error = paths[i] + " is not a partial output";
+            return false;
+        }
+    }
+    std::sort(headers.begin(), headers.end(),
+              [](const PartialHeader &a, const PartialHeader &b) {
+                  return a.shard.index < b.shard.index;
+              });
+
+    if (headers.empty()) {
+        error = "no partial outputs to merge";
+        return false;
+    }
+    unsigned count = headers[0].shard.count;
+    std::string twice, missing;
+    unsigned expected = 1;
+    for (size_t i = 0; i < headers.size(); i++) {
+        if (headers[i].shard.count != count) {
+            error = headers[i].path + " belongs to a run of " +
+                    std::to_string(headers[i].shard.count) + " shards, not " +
+                    std::to_string(count);
+            return false;
+        }
+        unsigned index = headers[i].shard.index;
+        if (index < expected) {
+            if (twice.empty())
+                twice = "shard " + std::to_string(index) + " of " +
+                        std::to_string(count) + " is given twice";
+            continue;
+        }
+        if (index > expected && missing.empty())
+            missing = "shard " + std::to_string(expected) + " of " +
+                      std::to_string(count) + " is missing";
+        expected = index + 1;
+    }
+    if (expected <= count && missing.empty())
+        missing = "shard " + std::to_string(expected) + " of " +
+                  std::to_string(count) + " is missing";
+    if (!twice.empty() || !missing.empty()) {
+        error = twice + (twice.empty() || missing.empty() ? "" : " and ") +
+                missing;
+        return false;
+    }
+
+    std::string kind;
+    for (const PartialHeader &header : headers) {
+        MappedFile file;
+        if (!file.open(header.path.c_str())) {
+            error = "could not read " + header.path;
+            return false;
+        }
+        PartialReader in(file.data(), file.size());
+        ShardSpec spec;
+        in.header(spec);
+
+        const char *section;
+        size_t length;
+        while (in.next(kind, section, length)) {
+            if (kind == "output") {
+                out.write(section, length);
+            } else if (kind == "lint") {
+                std::istringstream text(std::string(section, length));
+                LintSummary summary;
+                if (!summary.read(text)) {
+                    error = header.path + ": bad lint section";
+                    return false;
+                }
+                totals.lint.merge(summary);
+                totals.has_lint = true;
+            } else if (kind == "index") {
+                const char *newline =
+                    (const char *)memchr(section, '\n', length);
+                IndexShard shard;
+                if (!newline ||
+                    !shard.parse(newline + 1,
+                                 section + length - (newline + 1))) {
+                    error = header.path + ": bad index section";
+                    return false;
+                }
+                IndexShard &merged =
+                    totals.index[std::string(section, newline - section)];
+                for (auto &entry : shard.entries)
+                    merged.entries[entry.first] = entry.second;
+            }
+        }
+        if (!in.ended()) {
+            error = header.path + " is truncated";
+            return false;
+        }
+    }
+    return true;
+}
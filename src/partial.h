@@ -0,0 +1,125 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_PARTIAL_H
+#define UIDUMP_PARTIAL_H
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "bloom_index.h"
+#include "lint.h"
+
+// Which part of a batch run this process does: shard index (from 1) of
+// count. Inputs are split into count contiguous runs of the expanded
+// input list, kept in the order a single run reads it, so concatenating
+// the shards' output in order gives the output of a single run over the
+// same arguments.
+struct ShardSpec {
+    unsigned index = 1;
+    unsigned count = 1;
+};
+
+// Parses "i/N" with 1 <= i <= N.
+bool parse_shard_spec(const char *text, ShardSpec &out);
+
+// Keeps the inputs that belong to shard. Every shard must be given the
+// same arguments.
+void select_shard(const ShardSpec &shard, std::vector<std::string> &inputs);
+
+// Partial output of one shard. It starts with a
+//   uidump-partial 1 <index> <count>
+// line, followed by sections, each a "<kind> <length>" line and length
+// bytes:
+//   output  search output, in input order, in chunks of up to 64 KiB
+//   lint    a LintSummary in its text form
+//   index   a directory name line, then an IndexShard of it
+//   inputs  fingerprint of the inputs of a checkpointed run
+// and ends with an "end" line, so a truncated partial is noticed.
+class PartialWriter : private std::streambuf {
+  public:
+    explicit PartialWriter(std::ostream &out);
+
+    // Writes the header line; a partial being appended to has one already.
+    void begin(const ShardSpec &shard);
+
+    // Where the search output goes; it is framed into output sections.
+    std::ostream &output() { return output_; }
+
+    void add_lint(const LintSummary &summary);
+    void add_index(const IndexShards &shards);
+    // Sections of other kinds are skipped by merge_partials.
+    void add_section(const char *kind, const std::string &data);
+    // The framing of one section, for sections put together elsewhere.
+    static void frame_section(std::string &out, const char *kind,
+                              const std::string &data);
+
+    // Writes the end marker. False when anything failed to write.
+    bool finish();
+
+  private:
+    int overflow(int c) override;
+    int sync() override;
+    void write_section(const char *kind, const char *data, size_t size);
+
+    std::ostream &out_;
+    std::ostream output_;
+    char buffer_[64 * 1024];
+};
+
+// Walks the sections of a partial held in memory.
+class PartialReader {
+  public:
+    PartialReader(const char *data, size_t size)
+        : data_(data), size_(size) {}
+
+    bool header(ShardSpec &shard);
+
+    // The next section. False at the end marker, where ended() turns
+    // true, and at a truncated or damaged section.
+    bool next(std::string &kind, const char *&section, size_t &length);
+
+    bool ended() const { return ended_; }
+    // Bytes read so far; everything before it is whole sections.
+    size_t offset() const { return pos_; }
+
+  private:
+    bool read_line(std::string &word, size_t &number);
+
+    const char *data_;
+    size_t size_;
+    size_t pos_ = 0;
+    bool ended_ = false;
+};
+
+// What merge_partials collects besides the search output.
+struct PartialTotals {
+    bool has_lint = false;
+    LintSummary lint;
+    IndexShards index;
+};
+
+// Checks that paths hold every shard of one run exactly once, naming
+// each shard given twice or missing, then copies their output to out in
+// shard order and folds their aggregates into totals. An empty list is
+// an error. Each partial is read once.
+bool merge_partials(const std::vector<std::string> &paths, std::ostream &out,
+                    PartialTotals &totals, std::string &error);
+
+#endif // UIDUMP_PARTIAL_H
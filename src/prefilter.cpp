@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "prefilter.h"
+
+#include <cctype>
+#include <cstring>
+
+#include "memmem.h"
+
+void Prefilter::require(const QueryTerm &term) {
+    std::vector<uint64_t> keys;
+    query_index_keys(term, keys);
+    index_.require(keys);
+
+    const std::string &value = term.value;
+    // uiautomator's serializer has exactly one spelling for these three.
+    // Anything else with a choice of spelling (apostrophes, '>', control
+    // characters written as character references) cuts the value; only
+    // the longest unambiguous run is then searched for, without the
+    // attribute name around it.
+    std::string encoded, run, longest;
+    bool ambiguous = false;
+    for (char c : value) {
+        const char *entity = nullptr;
+        switch (c) {
+        case '&':
+            entity = "&amp;";
+            break;
+        case '<':
+            entity = "&lt;";
+            break;
+        case '"':
+            entity = "&quot;";
+            break;
+        }
+        if (c == '\'' || c == '>' || (unsigned char)c < 0x20) {
+            ambiguous = true;
+            if (run.size() > longest.size())
+                longest = run;
+            run.clear();
+            continue;
+        }
+        encoded += entity ? entity : std::string(1, c);
+        run += entity ? entity : std::string(1, c);
+    }
+    if (run.size() > longest.size())
+        longest = run;
+
+    if (needles_.empty())
+        needles_.emplace_back();
+    std::vector<std::string> &needles = needles_.back();
+    if (!ambiguous && term.exact)
+        needles.push_back(term.attribute + "=\"" + encoded + "\"");
+    else if (!ambiguous && !encoded.empty())
+        needles.push_back(encoded);
+    else if (!longest.empty())
+        needles.push_back(longest);
+}
+
+void Prefilter::alternative() {
+    if (!needles_.empty())
+        needles_.emplace_back();
+    index_.alternative();
+}
+
+// True when nothing in the bytes is spelled other than the way the
+// needles assume: values in double quotes, no whitespace around '=',
+// and character references only for control characters. Dumps that
+// did not come from uiautomator may spell a value differently, so a
+// needle missing from them proves nothing.
+static bool uiautomator_spelling(const char *data, size_t size) {
+    static const char *const others[] = {"='", "= ", " =", "&apos;"};
+    for (const char *other : others) {
+        if (find_bytes(data, size, other, strlen(other)))
+            return false;
+    }
+
+    const char *end = data + size;
+    for (const char *p = data; (p = find_bytes(p, end - p, "&#", 2));) {
+        p += 2;
+        bool hex = p < end && (*p == 'x' || *p == 'X');
+        unsigned long code = 0;
+        for (p += hex; p < end && isxdigit((unsigned char)*p); p++) {
+            if (!hex && !isdigit((unsigned char)*p))
+                break;
+            code = code * (hex ? 16 : 10) +
+                   (isdigit((unsigned char)*p) ? *p - '0'
+                                               : (*p | 0x20) - 'a' + 10);
+            if (code >= 0x20)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool Prefilter::may_match(const char *data, size_t size) const {
+    if (needles_.empty())
+        return true;
+    for (const std::vector<std::string> &needles : needles_) {
+        bool all = true;
+        for (const std::string &needle : needles) {
+            if (!find_bytes(data, size, needle.data(), needle.size())) {
+                all = false;
+                break;
+            }
+        }
+        if (all)
+            return true;
+    }
+    return !uiautomator_spelling(data, size);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_PREFILTER_H
+#define UIDUMP_PREFILTER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "bloom_index.h"
+#include "query.h"
+
+// Rejects dumps that cannot contain a match before anything is parsed.
+//
+// First, when the dump's directory has a fresh sidecar index, its Bloom
+// filter must hold every required key. Then the raw bytes are searched:
+// an exact attr=value term becomes a needle in the form uiautomator
+// writes it, attr="value" with & < " entity-encoded, and a substring
+// term becomes its encoded text. Every needle must be found for the file
+// to be parsed, unless the file spells values in some way uiautomator
+// does not, when the needles cannot rule it out.
+//
+// Several queries run at once, as from a query file, each require their
+// own terms after a call to alternative(); a file is then parsed when it
+// may match any one of them.
+class Prefilter {
+  public:
+    void require(const QueryTerm &term);
+    void alternative();
+
+    bool empty() const { return needles_.empty() && index_.empty(); }
+
+    // False only when the sidecar index proves the file holds no match.
+    bool may_match_indexed(const std::string &path) {
+        return index_.may_match(path);
+    }
+    size_t stale_index_entries() const { return index_.stale(); }
+
+    // False only when the bytes certainly hold no match.
+    bool may_match(const char *data, size_t size) const;
+
+  private:
+    std::vector<std::vector<std::string>> needles_; // one set per query
+    IndexLookup index_;
+};
+
+#endif // UIDUMP_PREFILTER_H
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "progress.h"
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+ProgressReporter::ProgressReporter(unsigned workers, size_t inputs,
+                                   bool human, FILE *json)
+    : counters_(workers + 1), completed_(0), inputs_(inputs),
+      human_(human), json_(json) {}
+
+void ProgressReporter::start() {
+    first_completed_ = completed_.load(std::memory_order_relaxed);
+    started_ns_ = last_ns_ = now_ns();
+    thread_ = std::thread(&ProgressReporter::run, this);
+}
+
+void ProgressReporter::stop() {
+    if (!thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+    report(true);
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> guard(lock_);
+    while (!wake_.wait_for(guard, std::chrono::seconds(1),
+                           [this] { return stopping_; })) {
+        guard.unlock();
+        report(false);
+        guard.lock();
+    }
+}
+
+void ProgressReporter::report(bool final) {
+    uint64_t files = 0, bytes = 0, read_ns = 0, parse_ns = 0;
+    for (const WorkerCounters &counters : counters_) {
+        files += counters.files.load(std::memory_order_relaxed);
+        bytes += counters.bytes.load(std::memory_order_relaxed);
+        read_ns += counters.read_ns.load(std::memory_order_relaxed);
+        parse_ns += counters.parse_ns.load(std::memory_order_relaxed);
+    }
+    size_t completed = completed_.load(std::memory_order_relaxed);
+    size_t waiting = queue_.waiting.load(std::memory_order_relaxed);
+    size_t buffered = queue_.buffered.load(std::memory_order_relaxed);
+
+    // Rates cover the last interval, or the whole run for the final
+    // report; the ETA assumes the run's average input rate holds.
+    uint64_t now = now_ns();
+    double seconds = (now - (final ? started_ns_ : last_ns_)) / 1e9;
+    double elapsed = (now - started_ns_) / 1e9;
+    uint64_t interval_files = final ? files : files - last_files_;
+    uint64_t interval_bytes = final ? bytes : bytes - last_bytes_;
+    double files_per_second = seconds > 0 ? interval_files / seconds : 0;
+    double mb_per_second =
+        seconds > 0 ? interval_bytes / seconds / (1024 * 1024) : 0;
+    double busy = read_ns + parse_ns;
+    double read_share = busy > 0 ? read_ns / busy : 0;
+    size_t done = completed - first_completed_;
+    double eta = done > 0 && !final
+                     ? elapsed / done * (inputs_ - completed)
+                     : 0;
+    last_ns_ = now;
+    last_files_ = files;
+    last_bytes_ = bytes;
+
+    if (human_) {
+        fprintf(stderr,
+                "%s: %zu/%zu inputs, %llu files, %.1f files/s, %.2f MB/s, "
+                "read %.0f%% / parse %.0f%%, queue %zu+%zu",
+                final ? "Done" : "Progress", completed, inputs_,
+                (unsigned long long)files, files_per_second, mb_per_second,
+                read_share * 100, (1 - read_share) * 100, waiting, buffered);
+        if (final)
+            fprintf(stderr, " in %.1fs\n", elapsed);
+        else if (done > 0)
+            fprintf(stderr, ", ETA %.0fs\n", eta);
+        else
+            fprintf(stderr, "\n");
+    }
+    if (json_) {
+        fprintf(json_,
+                "{\"elapsed\":%.3f,\"final\":%s,\"inputs\":%zu,"
+                "\"total_inputs\":%zu,\"files\":%llu,\"bytes\":%llu,"
+                "\"files_per_s\":%.2f,\"mb_per_s\":%.3f,"
+                "\"read_share\":%.3f,\"parse_share\":%.3f,"
+                "\"queue_waiting\":%zu,\"queue_buffered\":%zu,"
+                "\"eta_s\":%.1f}\n",
+                elapsed, final ? "true" : "false", completed, inputs_,
+                (unsigned long long)files, (unsigned long long)bytes,
+                files_per_second, mb_per_second, read_share, 1 - read_share,
+                waiting, buffered, eta);
+        fflush(json_);
+    }
+}
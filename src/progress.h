@@ -0,0 +1,123 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_PROGRESS_H
+#define UIDUMP_PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include "parallel.h"
+
+const size_t CACHE_LINE = 64;
+
+// What one worker has done so far. Only the worker writes its counters,
+// so a relaxed load and store replace a locked add, and the reporter
+// reads them relaxed as well. Each worker's counters fill a cache line of
+// their own, so two workers never write to the same line.
+struct alignas(CACHE_LINE) WorkerCounters {
+    std::atomic<uint64_t> files;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> read_ns; // opening, extracting, prefiltering
+    std::atomic<uint64_t> parse_ns; // parsing and searching
+
+    WorkerCounters() : files(0), bytes(0), read_ns(0), parse_ns(0) {}
+
+    static void add(std::atomic<uint64_t> &counter, uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount,
+                      std::memory_order_relaxed);
+    }
+};
+
+// Before C++17 operator new only guarantees alignment for fundamental
+// types, so a vector of WorkerCounters allocates through this instead.
+template <class T> struct CacheLineAllocator {
+    typedef T value_type;
+
+    CacheLineAllocator() = default;
+    template <class U> CacheLineAllocator(const CacheLineAllocator<U> &) {}
+
+    T *allocate(size_t n) {
+        void *p;
+        if (posix_memalign(&p, CACHE_LINE, n * sizeof(T)) != 0)
+            throw std::bad_alloc();
+        return static_cast<T *>(p);
+    }
+    void deallocate(T *p, size_t) { free(p); }
+
+    template <class U> bool operator==(const CacheLineAllocator<U> &) const {
+        return true;
+    }
+    template <class U> bool operator!=(const CacheLineAllocator<U> &) const {
+        return false;
+    }
+};
+
+uint64_t now_ns();
+
+// Prints the progress of a batch run once a second from its own thread:
+// as a line on stderr, as a JSON object per line to a file, or both.
+class ProgressReporter {
+  public:
+    // workers counters are handed out, plus one for the main thread.
+    ProgressReporter(unsigned workers, size_t inputs, bool human,
+                     FILE *json);
+    ~ProgressReporter() { stop(); }
+
+    WorkerCounters &worker(unsigned i) { return counters_[i]; }
+    WorkerCounters &main_thread() { return counters_.back(); }
+    OrderedQueue &queue() { return queue_; }
+
+    void set_completed(size_t inputs) {
+        completed_.store(inputs, std::memory_order_relaxed);
+    }
+
+    void start();
+    // Reports one last time and stops the thread.
+    void stop();
+
+  private:
+    void report(bool final);
+    void run();
+
+    std::vector<WorkerCounters, CacheLineAllocator<WorkerCounters>>
+        counters_;
+    OrderedQueue queue_;
+    std::atomic<size_t> completed_;
+    size_t inputs_;
+    size_t first_completed_ = 0;
+    bool human_;
+    FILE *json_;
+
+    uint64_t started_ns_ = 0;
+    uint64_t last_ns_ = 0, last_files_ = 0, last_bytes_ = 0;
+
+    std::thread thread_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+#endif // UIDUMP_PROGRESS_H
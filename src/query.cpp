@@ -0,0 +1,589 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "query.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace tinyxml2;
+
+QueryString intern_query_string(std::string &pool, const std::string &s) {
+    // Pools are small (a few hundred bytes per query), a scan is enough.
+    size_t offset = 0;
+    while (offset < pool.size()) {
+        size_t length = strlen(pool.c_str() + offset);
+        if (length == s.size() && pool.compare(offset, length, s) == 0) {
+            QueryString found = {(uint32_t)offset, (uint32_t)length};
+            return found;
+        }
+        offset += length + 1;
+    }
+    QueryString added = {(uint32_t)pool.size(), (uint32_t)s.size()};
+    pool += s;
+    pool += '\0';
+    return added;
+}
+
+namespace {
+
+struct Expr {
+    enum Kind { AND, OR, PREDICATE, CONSTANT } kind;
+    std::vector<Expr> children;
+    QueryOp op;
+    std::string attribute, value;
+    bool constant;
+
+    static Expr make_constant(bool value) {
+        Expr e;
+        e.kind = CONSTANT;
+        e.constant = value;
+        return e;
+    }
+
+    bool same_predicate(const Expr &o) const {
+        return kind == PREDICATE && o.kind == PREDICATE && op == o.op &&
+               attribute == o.attribute && value == o.value;
+    }
+};
+
+QueryOp negate(QueryOp op) {
+    switch (op) {
+    case QOP_EQUAL:
+        return QOP_NOT_EQUAL;
+    case QOP_NOT_EQUAL:
+        return QOP_EQUAL;
+    case QOP_CONTAINS:
+        return QOP_NOT_CONTAINS;
+    case QOP_NOT_CONTAINS:
+        return QOP_CONTAINS;
+    case QOP_PREFIX:
+        return QOP_NOT_PREFIX;
+    case QOP_NOT_PREFIX:
+        return QOP_PREFIX;
+    case QOP_PRESENT:
+        return QOP_EMPTY;
+    default:
+        return QOP_PRESENT;
+    }
+}
+
+// Pushes a negation down to the leaves (De Morgan), so the emitted code
+// never needs QOP_NOT.
+void negate(Expr &e) {
+    switch (e.kind) {
+    case Expr::AND:
+    case Expr::OR:
+        e.kind = e.kind == Expr::AND ? Expr::OR : Expr::AND;
+        for (Expr &child : e.children)
+            negate(child);
+        break;
+    case Expr::PREDICATE:
+        e.op = negate(e.op);
+        break;
+    case Expr::CONSTANT:
+        e.constant = !e.constant;
+        break;
+    }
+}
+
+class Parser {
+  public:
+    Parser(const std::string &text) : text_(text), pos_(0) {}
+
+    bool parse(Expr &out, std::string &error) {
+        if (!parse_or(out))
+            return fail(error);
+        skip_space();
+        if (pos_ != text_.size()) {
+            message_ = "unexpected input";
+            return fail(error);
+        }
+        return true;
+    }
+
+  private:
+    bool fail(std::string &error) {
+        std::ostringstream msg;
+        msg << message_ << " at offset " << pos_ << " in query '" << text_
+            << "'";
+        error = msg.str();
+        return false;
+    }
+
+    void skip_space() {
+        while (pos_ < text_.size() && isspace((unsigned char)text_[pos_]))
+            pos_++;
+    }
+
+    bool accept(const char *token) {
+        skip_space();
+        size_t n = strlen(token);
+        if (text_.compare(pos_, n, token) != 0)
+            return false;
+        pos_ += n;
+        return true;
+    }
+
+    bool parse_or(Expr &out) {
+        Expr first;
+        if (!parse_and(first))
+            return false;
+        if (!accept("||")) {
+            out = first;
+            return true;
+        }
+        out.kind = Expr::OR;
+        out.children.push_back(first);
+        do {
+            Expr next;
+            if (!parse_and(next))
+                return false;
+            out.children.push_back(next);
+        } while (accept("||"));
+        return true;
+    }
+
+    bool parse_and(Expr &out) {
+        Expr first;
+        if (!parse_unary(first))
+            return false;
+        if (!accept("&&")) {
+            out = first;
+            return true;
+        }
+        out.kind = Expr::AND;
+        out.children.push_back(first);
+        do {
+            Expr next;
+            if (!parse_unary(next))
+                return false;
+            out.children.push_back(next);
+        } while (accept("&&"));
+        return true;
+    }
+
+    bool parse_unary(Expr &out) {
+        if (accept("!")) {
+            if (!parse_unary(out))
+                return false;
+            negate(out);
+            return true;
+        }
+        if (accept("(")) {
+            if (!parse_or(out))
+                return false;
+            if (!accept(")")) {
+                message_ = "expected ')'";
+                return false;
+            }
+            return true;
+        }
+        return parse_predicate(out);
+    }
+
+    static bool is_name_char(char c) {
+        return isalnum((unsigned char)c) || c == '-' || c == '_' ||
+               c == ':' || c == '.';
+    }
+
+    bool parse_predicate(Expr &out) {
+        skip_space();
+        size_t start = pos_;
+        while (pos_ < text_.size() && is_name_char(text_[pos_]))
+            pos_++;
+        if (pos_ == start) {
+            message_ = "expected an attribute name";
+            return false;
+        }
+        out.kind = Expr::PREDICATE;
+        out.attribute = text_.substr(start, pos_ - start);
+
+        if (accept("==") || accept("=")) {
+            out.op = QOP_EQUAL;
+        } else if (accept("!=")) {
+            out.op = QOP_NOT_EQUAL;
+        } else if (accept("~")) {
+            out.op = QOP_CONTAINS;
+        } else if (accept("^=")) {
+            out.op = QOP_PREFIX;
+        } else {
+            if (out.attribute == "true" || out.attribute == "false")
+                out = Expr::make_constant(out.attribute == "true");
+            else
+                out.op = QOP_PRESENT;
+            return true;
+        }
+        return parse_value(out.value);
+    }
+
+    bool parse_value(std::string &out) {
+        skip_space();
+        if (pos_ < text_.size() && (text_[pos_] == '"' || text_[pos_] == '\'')) {
+            char quote = text_[pos_++];
+            size_t end = text_.find(quote, pos_);
+            if (end == std::string::npos) {
+                message_ = "unterminated string";
+                return false;
+            }
+            out = text_.substr(pos_, end - pos_);
+            pos_ = end + 1;
+            return true;
+        }
+        size_t start = pos_;
+        while (pos_ < text_.size() && !isspace((unsigned char)text_[pos_]) &&
+               text_[pos_] != ')' && text_.compare(pos_, 2, "&&") != 0 &&
+               text_.compare(pos_, 2, "||") != 0)
+            pos_++;
+        out = text_.substr(start, pos_ - start);
+        return true;
+    }
+
+    const std::string &text_;
+    size_t pos_;
+    const char *message_ = "syntax error";
+};
+
+// Constant folding: flattens nested &&/||, rewrites comparisons against
+// "" into presence tests, drops neutral constants, collapses absorbing
+// ones and removes repeated predicates.
+void fold(Expr &e) {
+    if (e.kind == Expr::PREDICATE) {
+        if (!e.value.empty())
+            return;
+        switch (e.op) {
+        case QOP_EQUAL:
+            e.op = QOP_EMPTY;
+            break;
+        case QOP_NOT_EQUAL:
+            e.op = QOP_PRESENT;
+            break;
+        case QOP_CONTAINS:
+        case QOP_PREFIX:
+            e = Expr::make_constant(true);
+            break;
+        case QOP_NOT_CONTAINS:
+        case QOP_NOT_PREFIX:
+            e = Expr::make_constant(false);
+            break;
+        default:
+            break;
+        }
+        return;
+    }
+    if (e.kind == Expr::CONSTANT)
+        return;
+
+    bool is_and = e.kind == Expr::AND;
+    std::vector<Expr> children;
+    for (Expr &child : e.children) {
+        fold(child);
+        if (child.kind == e.kind) {
+            for (Expr &grandchild : child.children)
+                children.push_back(grandchild);
+            continue;
+        }
+        if (child.kind == Expr::CONSTANT) {
+            if (child.constant != is_and) {
+                e = Expr::make_constant(!is_and);
+                return;
+            }
+            continue; // neutral element
+        }
+        children.push_back(child);
+    }
+
+    std::vector<Expr> unique;
+    for (Expr &child : children) {
+        bool repeated = false;
+        for (const Expr &kept : unique) {
+            if (kept.same_predicate(child)) {
+                repeated = true;
+                break;
+            }
+            if (kept.kind == Expr::PREDICATE &&
+                child.kind == Expr::PREDICATE && kept.op == negate(child.op) &&
+                kept.attribute == child.attribute &&
+                kept.value == child.value) {
+                // p && !p is false, p || !p is true
+                e = Expr::make_constant(!is_and);
+                return;
+            }
+        }
+        if (!repeated)
+            unique.push_back(child);
+    }
+
+    if (unique.empty())
+        e = Expr::make_constant(is_and);
+    else if (unique.size() == 1)
+        e = unique[0];
+    else
+        e.children.swap(unique);
+}
+
+// Rough cost of evaluating e. Equality on resource-id or text rules out
+// almost every node after one byte, so it goes first; presence tests
+// only look at the length; equality on repetitive attributes such as
+// class rarely fails early; prefix and substring tests scan the value.
+// Compound terms cost the sum of their parts.
+unsigned cost(const Expr &e) {
+    switch (e.kind) {
+    case Expr::CONSTANT:
+        return 0;
+    case Expr::PREDICATE:
+        switch (e.op) {
+        case QOP_PRESENT:
+        case QOP_EMPTY:
+            return 2;
+        case QOP_EQUAL:
+        case QOP_NOT_EQUAL:
+            return e.attribute == "resource-id" || e.attribute == "text" ? 1
+                                                                         : 3;
+        case QOP_PREFIX:
+        case QOP_NOT_PREFIX:
+            return 4;
+        default:
+            return 6;
+        }
+    default: {
+        unsigned total = 0;
+        for (const Expr &child : e.children)
+            total += cost(child);
+        return total;
+    }
+    }
+}
+
+// Reorders && and || operands cheapest first; both are commutative and
+// predicates have no side effects, so only the evaluation cost changes.
+void order_terms(Expr &e) {
+    if (e.kind != Expr::AND && e.kind != Expr::OR)
+        return;
+    for (Expr &child : e.children)
+        order_terms(child);
+    std::stable_sort(e.children.begin(), e.children.end(),
+                     [](const Expr &a, const Expr &b) {
+                         return cost(a) < cost(b);
+                     });
+}
+
+} // namespace
+
+class QueryCompiler {
+  public:
+    explicit QueryCompiler(Query &query) : q_(query) {}
+
+    bool emit(const Expr &e, std::string &error) {
+        switch (e.kind) {
+        case Expr::CONSTANT:
+            push(e.constant ? QOP_TRUE : QOP_FALSE, 0, 0);
+            return true;
+        case Expr::PREDICATE: {
+            int reg = register_for(e.attribute);
+            if (reg < 0) {
+                error = "query uses too many distinct attributes";
+                return false;
+            }
+            bool compares = e.op != QOP_PRESENT && e.op != QOP_EMPTY;
+            push(e.op, reg, compares ? constant_for(e.value) : 0);
+            return true;
+        }
+        default: {
+            // a && b: evaluate a, leave with false unless it held;
+            // a || b: evaluate a, leave with true if it held.
+            QueryOp jump =
+                e.kind == Expr::AND ? QOP_JUMP_IF_FALSE : QOP_JUMP_IF_TRUE;
+            std::vector<size_t> exits;
+            for (size_t i = 0; i < e.children.size(); i++) {
+                if (!emit(e.children[i], error))
+                    return false;
+                if (i + 1 < e.children.size()) {
+                    exits.push_back(q_.code_.size());
+                    push(jump, 0, 0);
+                }
+            }
+            for (size_t exit : exits)
+                q_.code_[exit].arg = q_.code_.size();
+            return true;
+        }
+        }
+    }
+
+    void finish(const Expr &root) {
+        push(QOP_RETURN, 0, 0);
+
+        // Jumps do not change the flag, so a jump landing on another jump
+        // already knows how that one resolves: the same kind is taken,
+        // the opposite kind falls through.
+        for (QueryInstruction &in : q_.code_) {
+            if (in.op != QOP_JUMP_IF_FALSE && in.op != QOP_JUMP_IF_TRUE)
+                continue;
+            for (;;) {
+                const QueryInstruction &next = q_.code_[in.arg];
+                if (next.op == in.op)
+                    in.arg = next.arg;
+                else if (next.op == QOP_JUMP_IF_FALSE ||
+                         next.op == QOP_JUMP_IF_TRUE)
+                    in.arg++;
+                else
+                    break;
+            }
+        }
+
+        q_.required_.clear();
+        if (root.kind == Expr::PREDICATE)
+            add_required(root);
+        if (root.kind == Expr::AND) {
+            for (const Expr &child : root.children) {
+                if (child.kind == Expr::PREDICATE)
+                    add_required(child);
+            }
+        }
+    }
+
+  private:
+    void push(QueryOp op, int reg, uint32_t arg) {
+        QueryInstruction in = {(uint8_t)op, (uint8_t)reg, 0, arg};
+        q_.code_.push_back(in);
+    }
+
+    int register_for(const std::string &name) {
+        for (size_t i = 0; i < q_.registers_.size(); i++) {
+            if (name == q_.pool_.c_str() + q_.registers_[i].offset)
+                return i;
+        }
+        if (q_.registers_.size() == QUERY_MAX_REGISTERS)
+            return -1;
+        q_.registers_.push_back(intern_query_string(q_.pool_, name));
+        return q_.registers_.size() - 1;
+    }
+
+    uint32_t constant_for(const std::string &value) {
+        QueryString s = intern_query_string(q_.pool_, value);
+        for (size_t i = 0; i < q_.constants_.size(); i++) {
+            if (q_.constants_[i].offset == s.offset)
+                return i;
+        }
+        q_.constants_.push_back(s);
+        return q_.constants_.size() - 1;
+    }
+
+    void add_required(const Expr &e) {
+        if (e.op != QOP_EQUAL && e.op != QOP_CONTAINS)
+            return;
+        QueryTerm term = {e.attribute, e.value, e.op == QOP_EQUAL};
+        q_.required_.push_back(term);
+    }
+
+    Query &q_;
+};
+
+bool Query::compile(const std::string &text, std::string &error) {
+    code_.clear();
+    registers_.clear();
+    constants_.clear();
+    pool_.clear();
+    required_.clear();
+
+    Expr root;
+    Parser parser(text);
+    if (!parser.parse(root, error))
+        return false;
+    fold(root);
+    order_terms(root);
+
+    QueryCompiler compiler(*this);
+    if (!compiler.emit(root, error))
+        return false;
+    compiler.finish(root);
+    return true;
+}
+
+QueryProgram Query::program() const {
+    QueryProgram p = {code_.data(),      (uint32_t)code_.size(),
+                      registers_.data(), (uint32_t)registers_.size(),
+                      constants_.data(), (uint32_t)constants_.size(),
+                      pool_.c_str()};
+    return p;
+}
+
+void Query::required_terms(std::vector<QueryTerm> &out) const {
+    out.insert(out.end(), required_.begin(), required_.end());
+}
+
+void Query::disassemble(std::ostream &out) const {
+    static const char *names[] = {
+        "eq",      "ne",    "contains", "!contains", "prefix", "!prefix",
+        "present", "empty", "true",     "false",     "not",    "jf",
+        "jt",      "ret",
+    };
+    QueryProgram p = program();
+    for (size_t pc = 0; pc < code_.size(); pc++) {
+        const QueryInstruction &in = code_[pc];
+        out << "  " << pc << ": " << names[in.op];
+        if (in.op <= QOP_EMPTY)
+            out << " r" << (int)in.reg << "(" << p.register_name(in.reg)
+                << ")";
+        if (in.op < QOP_PRESENT)
+            out << ", \"" << p.string(p.constants[in.arg]) << "\"";
+        if (in.op == QOP_JUMP_IF_FALSE || in.op == QOP_JUMP_IF_TRUE)
+            out << " " << in.arg;
+        out << "\n";
+    }
+}
+
+bool query_tests_equality(const QueryProgram &program,
+                          const char *const *names) {
+    for (uint32_t pc = 0; pc < program.code_size; pc++) {
+        const QueryInstruction &in = program.code[pc];
+        if (in.op != QOP_EQUAL && in.op != QOP_NOT_EQUAL)
+            continue;
+        for (const char *const *name = names; *name; name++) {
+            if (strcmp(*name, program.register_name(in.reg)) == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+const QueryInterning *QueryInterner::resolve(const QueryProgram &program,
+                                             XMLDocument &doc) {
+    constants_.assign(program.constant_count, nullptr);
+    interning_.registers = 0;
+    interning_.constants = constants_.data();
+    for (uint32_t pc = 0; pc < program.code_size; pc++) {
+        const QueryInstruction &in = program.code[pc];
+        if ((in.op != QOP_EQUAL && in.op != QOP_NOT_EQUAL) ||
+            !doc.InternsAttribute(program.register_name(in.reg)))
+            continue;
+        interning_.registers |= 1ULL << in.reg;
+        constants_[in.arg] =
+            doc.InternValue(program.string(program.constants[in.arg]));
+    }
+    return interning_.registers ? &interning_ : nullptr;
+}
+
+void collect_matching(const XMLElement *root, const QueryProgram &program,
+                      std::vector<const XMLElement *> &out) {
+    if (query_matches(program, root))
+        out.push_back(root);
+    for (const XMLElement *child = root->FirstChildElement(); child != nullptr;
+         child = child->NextSiblingElement()) {
+        collect_matching(child, program, out);
+    }
+}
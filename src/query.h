@@ -0,0 +1,286 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_QUERY_H
+#define UIDUMP_QUERY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "tinyxml2/tinyxml2.h"
+
+// Boolean node queries, e.g.
+//
+//   (class=android.widget.Button || class=android.widget.ImageButton)
+//       && enabled=true && !text=""
+//
+// Predicates are <attr>=<value>, <attr>!=<value>, <attr>~<substring>,
+// <attr>^=<prefix> or a bare <attr> (present and non-empty); a missing
+// attribute reads as "". Values are bare words or quoted with ' or ".
+// Predicates combine with !, &&, || and parentheses.
+//
+// A query compiles to bytecode for a small register machine. Every
+// distinct attribute name gets a register that is loaded from the node
+// the first time an instruction needs it; comparisons set a flag that
+// conditional jumps test, which gives && and || their short-circuit.
+
+enum QueryOp : uint8_t {
+    QOP_EQUAL,        // flag = reg == constant
+    QOP_NOT_EQUAL,    // flag = reg != constant
+    QOP_CONTAINS,     // flag = constant occurs in reg
+    QOP_NOT_CONTAINS, //
+    QOP_PREFIX,       // flag = reg starts with constant
+    QOP_NOT_PREFIX,   //
+    QOP_PRESENT,      // flag = reg is non-empty
+    QOP_EMPTY,        // flag = reg is empty or missing
+    QOP_TRUE,         // flag = true
+    QOP_FALSE,        // flag = false
+    QOP_NOT,          // flag = !flag
+    QOP_JUMP_IF_FALSE,
+    QOP_JUMP_IF_TRUE,
+    QOP_RETURN, // result is flag
+};
+
+struct QueryInstruction {
+    uint8_t op;
+    uint8_t reg;   // attribute register for comparisons
+    uint16_t pad;
+    uint32_t arg;  // constant index, or jump target
+};
+
+// Offset and length of a NUL-terminated string in the program's pool.
+struct QueryString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+static const unsigned QUERY_MAX_REGISTERS = 64;
+
+// Read-only view of a compiled query. Everything lives in flat arrays
+// so a view can point into a Query or straight into a mapped plan file.
+struct QueryProgram {
+    const QueryInstruction *code;
+    uint32_t code_size;
+    const QueryString *registers; // attribute name per register
+    uint32_t register_count;
+    const QueryString *constants;
+    uint32_t constant_count;
+    const char *pool;
+
+    const char *string(const QueryString &s) const { return pool + s.offset; }
+    const char *register_name(unsigned reg) const {
+        return string(registers[reg]);
+    }
+};
+
+// An attribute value, or part of one, that every match must contain.
+struct QueryTerm {
+    std::string attribute;
+    std::string value;
+    bool exact; // the whole value, rather than a substring of it
+};
+
+class Query {
+  public:
+    // Compiles text, replacing any previous program. On failure error
+    // says what went wrong and where.
+    bool compile(const std::string &text, std::string &error);
+
+    QueryProgram program() const;
+
+    // Equality and substring predicates every match must satisfy (the
+    // top-level && terms), for prefilters that can rule out a file.
+    void required_terms(std::vector<QueryTerm> &out) const;
+
+    void disassemble(std::ostream &out) const;
+
+  private:
+    friend class QueryCompiler;
+
+    std::vector<QueryInstruction> code_;
+    std::vector<QueryString> registers_;
+    std::vector<QueryString> constants_;
+    std::string pool_;
+    std::vector<QueryTerm> required_;
+};
+
+// Interns s into pool, returning where it lives. Equal strings share one
+// entry so the plan stays small.
+QueryString intern_query_string(std::string &pool, const std::string &s);
+
+static inline bool query_contains(const char *haystack, size_t length,
+                                  const char *needle, size_t needle_length) {
+    if (needle_length == 0)
+        return true;
+    if (needle_length > length)
+        return false;
+    const char *last = haystack + length - needle_length;
+    for (const char *p = haystack; p <= last; p++) {
+        p = (const char *)memchr(p, needle[0], last - p + 1);
+        if (!p)
+            return false;
+        if (memcmp(p, needle, needle_length) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Lets run_query() compare values by pointer in a document that
+// interns them: registers has a bit for each register whose attribute
+// the document interns, and constants holds the document's copy of
+// each constant those registers are tested for equality with.
+struct QueryInterning {
+    uint64_t registers;
+    const char *const *constants;
+};
+
+// Resolves programs against documents that intern attribute values,
+// reusing its storage so that a warm resolver does not allocate.
+class QueryInterner {
+  public:
+    // Null when no equality in program tests an attribute doc interns.
+    // Valid until doc is cleared or the next resolve().
+    const QueryInterning *resolve(const QueryProgram &program,
+                                  tinyxml2::XMLDocument &doc);
+
+  private:
+    std::vector<const char *> constants_;
+    QueryInterning interning_;
+};
+
+// Whether some equality in program tests an attribute in names, a null
+// terminated list.
+bool query_tests_equality(const QueryProgram &program,
+                          const char *const *names);
+
+// Runs a compiled query against one node. Attributes supplies register
+// values through get(reg, value, length), which must leave value null or
+// set length for a missing attribute; it is asked at most once per
+// register. With interning, equality on interned registers is a pointer
+// compare.
+template <typename Attributes>
+bool run_query(const QueryProgram &program, Attributes &attributes,
+               const QueryInterning *interning = nullptr) {
+    const char *values[QUERY_MAX_REGISTERS];
+    size_t lengths[QUERY_MAX_REGISTERS];
+    uint64_t loaded = 0;
+    bool flag = false;
+
+    const QueryInstruction *code = program.code;
+    for (uint32_t pc = 0;;) {
+        const QueryInstruction &in = code[pc++];
+        if (in.op <= QOP_EMPTY) {
+            uint64_t bit = 1ULL << in.reg;
+            if (!(loaded & bit)) {
+                if (!attributes.get(in.reg, values[in.reg],
+                                    lengths[in.reg])) {
+                    values[in.reg] = "";
+                    lengths[in.reg] = 0;
+                }
+                loaded |= bit;
+            }
+            const char *value = values[in.reg];
+            size_t length = lengths[in.reg];
+            if (in.op >= QOP_PRESENT) {
+                flag = (length != 0) == (in.op == QOP_PRESENT);
+                continue;
+            }
+
+            const QueryString &c = program.constants[in.arg];
+            const char *constant = program.pool + c.offset;
+            switch (in.op) {
+            case QOP_EQUAL:
+            case QOP_NOT_EQUAL:
+                // Folding turned comparisons with "" into QOP_EMPTY and
+                // QOP_PRESENT, so a constant here has a first byte.
+                if (interning && (interning->registers >> in.reg & 1))
+                    flag = value == interning->constants[in.arg];
+                else
+                    flag = length == c.length && value[0] == constant[0] &&
+                           memcmp(value, constant, length) == 0;
+                flag ^= in.op == QOP_NOT_EQUAL;
+                break;
+            case QOP_CONTAINS:
+            case QOP_NOT_CONTAINS:
+                flag = query_contains(value, length, constant, c.length);
+                flag ^= in.op == QOP_NOT_CONTAINS;
+                break;
+            default: // QOP_PREFIX, QOP_NOT_PREFIX
+                flag = length >= c.length &&
+                       memcmp(value, constant, c.length) == 0;
+                flag ^= in.op == QOP_NOT_PREFIX;
+                break;
+            }
+            continue;
+        }
+
+        switch (in.op) {
+        case QOP_TRUE:
+            flag = true;
+            break;
+        case QOP_FALSE:
+            flag = false;
+            break;
+        case QOP_NOT:
+            flag = !flag;
+            break;
+        case QOP_JUMP_IF_FALSE:
+            if (!flag)
+                pc = in.arg;
+            break;
+        case QOP_JUMP_IF_TRUE:
+            if (flag)
+                pc = in.arg;
+            break;
+        default: // QOP_RETURN
+            return flag;
+        }
+    }
+}
+
+// Register loader for tinyxml2 elements.
+struct ElementAttributes {
+    const QueryProgram &program;
+    const tinyxml2::XMLElement *element;
+
+    bool get(unsigned reg, const char *&value, size_t &length) {
+        value = element->Attribute(program.register_name(reg));
+        if (!value)
+            return false;
+        length = strlen(value);
+        return true;
+    }
+};
+
+inline bool query_matches(const QueryProgram &program,
+                          const tinyxml2::XMLElement *element,
+                          const QueryInterning *interning = nullptr) {
+    ElementAttributes attributes = {program, element};
+    return run_query(program, attributes, interning);
+}
+
+// Appends every element under (and including) root that matches, in
+// document order.
+void collect_matching(const tinyxml2::XMLElement *root,
+                      const QueryProgram &program,
+                      std::vector<const tinyxml2::XMLElement *> &out);
+
+#endif // UIDUMP_QUERY_H
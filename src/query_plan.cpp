@@ -0,0 +1,419 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "query_plan.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+static const char PLAN_MAGIC[8] = {'U', 'I', 'D', 'Q', 'P', 'L', 'A', 'N'};
+static const uint32_t PLAN_VERSION = 2;
+
+// On-disk layout, native endianness (a plan is a local cache, it is not
+// meant to move between machines):
+//
+//   PlanHeader
+//   PlanQuery[query_count]
+//   QueryInstruction[instruction_count]
+//   QueryString[string_count]   registers and constants of all queries
+//   PlanTerm[term_count]        required terms of all queries
+//   char[pool_size]             NUL-terminated strings, each stored once
+struct PlanHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t query_count;
+    uint64_t source_hash;
+    uint32_t instruction_count;
+    uint32_t string_count;
+    uint32_t pool_size;
+    uint32_t term_count;
+};
+
+struct PlanQuery {
+    uint32_t name; // pool offset
+    uint32_t code;
+    uint32_t code_size;
+    uint32_t registers;
+    uint32_t register_count;
+    uint32_t constants;
+    uint32_t constant_count;
+    uint32_t terms;
+    uint32_t term_count;
+};
+
+// A Query::required_terms() entry, kept so a cached plan can still set
+// up the prefilter.
+struct PlanTerm {
+    uint32_t attribute; // pool offsets
+    uint32_t value;
+    uint32_t exact;
+};
+
+static uint64_t hash_source(const std::string &text) {
+    uint64_t h = 14695981039346656037ULL ^ PLAN_VERSION;
+    for (unsigned char c : text) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static std::string trim(const std::string &s) {
+    size_t start = s.find_first_not_of(" \t\r");
+    if (start == std::string::npos)
+        return "";
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(start, end - start + 1);
+}
+
+static bool is_name(const std::string &s) {
+    if (s.empty())
+        return false;
+    for (char c : s) {
+        if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.')
+            return false;
+    }
+    return true;
+}
+
+namespace {
+
+// Serializes compiled queries into one plan, interning every string into
+// a pool shared by all of them.
+class PlanBuilder {
+  public:
+    void add(const std::string &name, const Query &query) {
+        QueryProgram p = query.program();
+        PlanQuery q;
+        q.name = intern(name);
+        q.code = code_.size();
+        q.code_size = p.code_size;
+        code_.insert(code_.end(), p.code, p.code + p.code_size);
+
+        q.registers = strings_.size();
+        q.register_count = p.register_count;
+        for (uint32_t i = 0; i < p.register_count; i++)
+            strings_.push_back(rebase(p, p.registers[i]));
+
+        q.constants = strings_.size();
+        q.constant_count = p.constant_count;
+        for (uint32_t i = 0; i < p.constant_count; i++)
+            strings_.push_back(rebase(p, p.constants[i]));
+
+        std::vector<QueryTerm> required;
+        query.required_terms(required);
+        q.terms = terms_.size();
+        q.term_count = required.size();
+        for (const QueryTerm &term : required) {
+            PlanTerm t = {intern(term.attribute), intern(term.value),
+                          term.exact};
+            terms_.push_back(t);
+        }
+        queries_.push_back(q);
+    }
+
+    std::string finish(uint64_t source_hash) {
+        PlanHeader header = {};
+        memcpy(header.magic, PLAN_MAGIC, sizeof(PLAN_MAGIC));
+        header.version = PLAN_VERSION;
+        header.query_count = queries_.size();
+        header.source_hash = source_hash;
+        header.instruction_count = code_.size();
+        header.string_count = strings_.size();
+        header.pool_size = pool_.size();
+        header.term_count = terms_.size();
+
+        std::string out;
+        out.append((const char *)&header, sizeof(header));
+        out.append((const char *)queries_.data(),
+                   queries_.size() * sizeof(PlanQuery));
+        out.append((const char *)code_.data(),
+                   code_.size() * sizeof(QueryInstruction));
+        out.append((const char *)strings_.data(),
+                   strings_.size() * sizeof(QueryString));
+        out.append((const char *)terms_.data(),
+                   terms_.size() * sizeof(PlanTerm));
+        out.append(pool_);
+        return out;
+    }
+
+  private:
+    uint32_t intern(const std::string &s) {
+        auto it = offsets_.find(s);
+        if (it != offsets_.end())
+            return it->second;
+        uint32_t offset = pool_.size();
+        pool_.append(s.c_str(), s.size() + 1);
+        offsets_[s] = offset;
+        return offset;
+    }
+
+    QueryString rebase(const QueryProgram &p, const QueryString &s) {
+        QueryString out = {intern(p.string(s)), s.length};
+        return out;
+    }
+
+    std::vector<PlanQuery> queries_;
+    std::vector<QueryInstruction> code_;
+    std::vector<QueryString> strings_;
+    std::vector<PlanTerm> terms_;
+    std::string pool_;
+    std::unordered_map<std::string, uint32_t> offsets_;
+};
+
+} // namespace
+
+QueryPlan::~QueryPlan() {
+    if (mapping_)
+        munmap(mapping_, mapping_size_);
+}
+
+static bool parse_queries(const std::string &source_path,
+                          const std::string &text,
+                          std::vector<NamedQuery> &out, std::string &error) {
+    std::istringstream in(text);
+    std::string line;
+    for (unsigned lineno = 1; std::getline(in, line); lineno++) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::string name, expression = line;
+        size_t colon = line.find(':');
+        if (colon != std::string::npos && is_name(trim(line.substr(0, colon)))) {
+            // "name: query"; a colon inside a query such as
+            // resource-id=com.example:id/x is not followed by a space.
+            if (colon + 1 == line.size() || line[colon + 1] == ' ' ||
+                line[colon + 1] == '\t') {
+                name = trim(line.substr(0, colon));
+                expression = trim(line.substr(colon + 1));
+            }
+        }
+        if (name.empty())
+            name = "line-" + std::to_string(lineno);
+
+        NamedQuery named;
+        named.name = name;
+        std::string message;
+        if (!named.query.compile(expression, message)) {
+            std::ostringstream msg;
+            msg << source_path << ":" << lineno << ": " << message;
+            error = msg.str();
+            return false;
+        }
+        out.push_back(named);
+    }
+    return true;
+}
+
+static bool read_source(const std::string &source_path, std::string &text,
+                        std::string &error) {
+    std::ifstream in(source_path.c_str(), std::ios::binary);
+    if (!in) {
+        error = "could not open " + source_path;
+        return false;
+    }
+    std::ostringstream source;
+    source << in.rdbuf();
+    text = source.str();
+    return true;
+}
+
+bool load_queries(const std::string &source_path,
+                  std::vector<NamedQuery> &out, std::string &error) {
+    std::string text;
+    return read_source(source_path, text, error) &&
+           parse_queries(source_path, text, out, error);
+}
+
+bool QueryPlan::load(const std::string &source_path, std::string cache_path,
+                     std::string &error) {
+    std::string text;
+    if (!read_source(source_path, text, error))
+        return false;
+    uint64_t source_hash = hash_source(text);
+
+    if (cache_path.empty())
+        cache_path = source_path + ".plan";
+
+    int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd,
+                              0);
+            if (data != MAP_FAILED) {
+                if (attach((const char *)data, st.st_size, source_hash)) {
+                    mapping_ = data;
+                    mapping_size_ = st.st_size;
+                    close(fd);
+                    return true;
+                }
+                munmap(data, st.st_size);
+            }
+        }
+        close(fd);
+    }
+
+    std::vector<NamedQuery> queries;
+    if (!parse_queries(source_path, text, queries, error))
+        return false;
+    PlanBuilder builder;
+    for (const NamedQuery &named : queries)
+        builder.add(named.name, named.query);
+    built_ = builder.finish(source_hash);
+
+    // Write to a temporary and rename, so a concurrent run never maps a
+    // half-written plan.
+    std::string temp = cache_path + ".tmp" + std::to_string(getpid());
+    FILE *out = fopen(temp.c_str(), "wb");
+    if (out) {
+        bool written =
+            fwrite(built_.data(), 1, built_.size(), out) == built_.size();
+        if (fclose(out) == 0 && written)
+            rename(temp.c_str(), cache_path.c_str());
+        else
+            remove(temp.c_str());
+    }
+
+    return attach(built_.data(), built_.size(), source_hash);
+}
+
+bool QueryPlan::attach(const char *data, size_t size, uint64_t source_hash) {
+    if (size < sizeof(PlanHeader))
+        return false;
+    const PlanHeader *header = (const PlanHeader *)data;
+    if (memcmp(header->magic, PLAN_MAGIC, sizeof(PLAN_MAGIC)) != 0 ||
+        header->version != PLAN_VERSION ||
+        header->source_hash != source_hash)
+        return false;
+
+    size_t expected = sizeof(PlanHeader) +
+                      (size_t)header->query_count * sizeof(PlanQuery) +
+                      (size_t)header->instruction_count *
+                          sizeof(QueryInstruction) +
+                      (size_t)header->string_count * sizeof(QueryString) +
+                      (size_t)header->term_count * sizeof(PlanTerm) +
+                      header->pool_size;
+    if (expected != size)
+        return false;
+
+    base_ = data;
+    count_ = header->query_count;
+
+    // The plan is trusted to run without bounds checks, so make sure a
+    // damaged cache cannot send the interpreter out of its arrays.
+    const PlanQuery *queries = (const PlanQuery *)(header + 1);
+    const char *pool = data + size - header->pool_size;
+    for (size_t i = 0; i < count_; i++) {
+        const PlanQuery &q = queries[i];
+        if (q.name >= header->pool_size || q.code_size == 0 ||
+            q.code + (uint64_t)q.code_size > header->instruction_count ||
+            q.register_count > QUERY_MAX_REGISTERS ||
+            q.registers + (uint64_t)q.register_count > header->string_count ||
+            q.constants + (uint64_t)q.constant_count > header->string_count ||
+            q.terms + (uint64_t)q.term_count > header->term_count)
+            return false;
+
+        QueryProgram p = program(i);
+        for (uint32_t s = 0; s < p.register_count + p.constant_count; s++) {
+            const QueryString &str =
+                s < p.register_count ? p.registers[s]
+                                     : p.constants[s - p.register_count];
+            if ((uint64_t)str.offset + str.length >= header->pool_size ||
+                pool[str.offset + str.length] != '\0')
+                return false;
+        }
+        for (uint32_t pc = 0; pc < p.code_size; pc++) {
+            const QueryInstruction &in = p.code[pc];
+            if (in.op > QOP_RETURN)
+                return false;
+            if (in.op <= QOP_EMPTY && in.reg >= p.register_count)
+                return false;
+            if (in.op < QOP_PRESENT && in.arg >= p.constant_count)
+                return false;
+            if ((in.op == QOP_JUMP_IF_FALSE || in.op == QOP_JUMP_IF_TRUE) &&
+                (in.arg <= pc || in.arg >= p.code_size))
+                return false;
+        }
+        if (p.code[p.code_size - 1].op != QOP_RETURN)
+            return false;
+    }
+    if (header->pool_size && pool[header->pool_size - 1] != '\0')
+        return false;
+    const PlanTerm *terms = (const PlanTerm *)(pool - header->term_count *
+                                                          sizeof(PlanTerm));
+    for (size_t i = 0; i < header->term_count; i++) {
+        if (terms[i].attribute >= header->pool_size ||
+            terms[i].value >= header->pool_size)
+            return false;
+    }
+    return true;
+}
+
+const char *QueryPlan::name(size_t i) const {
+    const PlanHeader *header = (const PlanHeader *)base_;
+    const PlanQuery *queries = (const PlanQuery *)(header + 1);
+    return pool() + queries[i].name;
+}
+
+const char *QueryPlan::pool() const {
+    const PlanHeader *header = (const PlanHeader *)base_;
+    return base_ + sizeof(PlanHeader) +
+           header->query_count * sizeof(PlanQuery) +
+           header->instruction_count * sizeof(QueryInstruction) +
+           header->string_count * sizeof(QueryString) +
+           header->term_count * sizeof(PlanTerm);
+}
+
+void QueryPlan::required_terms(size_t i, std::vector<QueryTerm> &out) const {
+    const PlanHeader *header = (const PlanHeader *)base_;
+    const PlanQuery &q = ((const PlanQuery *)(header + 1))[i];
+    const char *strings = pool();
+    const PlanTerm *terms =
+        (const PlanTerm *)(strings - header->term_count * sizeof(PlanTerm));
+    for (uint32_t t = q.terms; t < q.terms + q.term_count; t++) {
+        out.push_back(QueryTerm{strings + terms[t].attribute,
+                                strings + terms[t].value,
+                                terms[t].exact != 0});
+    }
+}
+
+QueryProgram QueryPlan::program(size_t i) const {
+    const PlanHeader *header = (const PlanHeader *)base_;
+    const PlanQuery *queries = (const PlanQuery *)(header + 1);
+    const QueryInstruction *code =
+        (const QueryInstruction *)(queries + header->query_count);
+    const QueryString *strings =
+        (const QueryString *)(code + header->instruction_count);
+    const char *pool = (const char *)((const PlanTerm *)(strings +
+                                                         header->string_count) +
+                                      header->term_count);
+
+    const PlanQuery &q = queries[i];
+    QueryProgram p = {code + q.code,         q.code_size,
+                      strings + q.registers, q.register_count,
+                      strings + q.constants, q.constant_count,
+                      pool};
+    return p;
+}
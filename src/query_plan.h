@@ -0,0 +1,80 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_QUERY_PLAN_H
+#define UIDUMP_QUERY_PLAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "query.h"
+
+// A file of named queries, one per line:
+//
+//   # comment
+//   login-button: resource-id=com.example:id/login && enabled=true
+//   class=android.widget.EditText
+//
+// Unnamed queries are named after their line number. The compiled form
+// is cached next to the source as a binary plan whose header carries a
+// hash of the source text. When the hash still matches, later runs map
+// the plan read-only and execute straight from the mapping, skipping
+// parsing and compilation.
+class QueryPlan {
+  public:
+    QueryPlan() = default;
+    QueryPlan(const QueryPlan &) = delete;
+    QueryPlan &operator=(const QueryPlan &) = delete;
+    ~QueryPlan();
+
+    // cache_path defaults to "<source_path>.plan". A cache that cannot be
+    // written is not an error; the plan is then kept in memory.
+    bool load(const std::string &source_path, std::string cache_path,
+              std::string &error);
+
+    size_t size() const { return count_; }
+    const char *name(size_t i) const;
+    QueryProgram program(size_t i) const;
+    // Appends what Query::required_terms() gives for query i.
+    void required_terms(size_t i, std::vector<QueryTerm> &out) const;
+    bool cached() const { return mapping_ != nullptr; }
+
+  private:
+    bool attach(const char *data, size_t size, uint64_t source_hash);
+    const char *pool() const;
+
+    void *mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    std::string built_; // plan bytes when not mapped
+
+    const char *base_ = nullptr;
+    size_t count_ = 0;
+};
+
+struct NamedQuery {
+    std::string name;
+    Query query;
+};
+
+// Compiles every query of a query file, for callers that need the Query
+// objects themselves rather than a plan.
+bool load_queries(const std::string &source_path,
+                  std::vector<NamedQuery> &out, std::string &error);
+
+#endif // UIDUMP_QUERY_PLAN_H
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "radix.h"
+
+#include <cstring>
+
+void radix_sort_by_key(const std::vector<uint32_t> &keys,
+                       std::vector<uint32_t> &order) {
+    std::vector<uint32_t> scratch(order.size());
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t counts[257];
+        memset(counts, 0, sizeof(counts));
+        for (uint32_t index : order)
+            counts[((keys[index] >> shift) & 0xff) + 1]++;
+
+        bool single_bucket = false;
+        for (int b = 1; b <= 256; b++) {
+            if (counts[b] == order.size()) {
+                single_bucket = true;
+                break;
+            }
+        }
+        if (single_bucket)
+            continue;
+
+        for (int b = 1; b <= 256; b++)
+            counts[b] += counts[b - 1];
+        for (uint32_t index : order)
+            scratch[counts[(keys[index] >> shift) & 0xff]++] = index;
+        order.swap(scratch);
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_RADIX_H
+#define UIDUMP_RADIX_H
+
+#include <cstdint>
+#include <vector>
+
+// Maps a signed coordinate onto an unsigned key with the same ordering.
+inline uint32_t radix_key(int value) {
+    return (uint32_t)value ^ 0x80000000u;
+}
+
+// Stable LSD radix sort of order[] by keys[order[i]], one byte per pass.
+// Passes where every key shares the same byte are skipped, so screen
+// coordinates (which rarely exceed 16 bits) cost two passes.
+void radix_sort_by_key(const std::vector<uint32_t> &keys,
+                       std::vector<uint32_t> &order);
+
+#endif // UIDUMP_RADIX_H
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replay.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+
+#include "archive.h"
+#include "debug.h"
+#include "engine.h"
+#include "mapped_file.h"
+#include "progress.h"
+#include "query_plan.h"
+
+// Untimed passes over the corpus before the timed ones, so every engine
+// starts with warm caches and a grown allocator.
+static const unsigned REPLAY_WARMUP_PASSES = 1;
+static const unsigned REPLAY_PASSES = 3;
+
+namespace {
+
+struct SizeBucket {
+    size_t limit; // dumps smaller than this
+    const char *label;
+};
+
+const SizeBucket BUCKETS[] = {
+    {16 << 10, "<16K"},       {64 << 10, "16K-64K"},
+    {256 << 10, "64K-256K"},  {1 << 20, "256K-1M"},
+    {(size_t)-1, ">=1M"},
+};
+const size_t BUCKET_COUNT = sizeof(BUCKETS) / sizeof(BUCKETS[0]);
+
+size_t bucket_of(size_t size) {
+    size_t i = 0;
+    while (size >= BUCKETS[i].limit)
+        i++;
+    return i;
+}
+
+// Nearest-rank percentile of sorted samples.
+uint64_t percentile(const std::vector<uint64_t> &sorted, double p) {
+    size_t rank = (size_t)(p * sorted.size() + 0.999999);
+    return sorted[rank ? rank - 1 : 0];
+}
+
+double megabytes(double bytes) {
+    return bytes / (1024 * 1024);
+}
+
+// Peak resident set in bytes, of this process or of its reaped children.
+double peak_rss(const struct rusage &usage) {
+    return usage.ru_maxrss * 1024.0; // kilobytes on Linux and Android
+}
+
+void replay_engine(const EngineInfo &info,
+                   const std::vector<std::string> &dumps,
+                   const std::vector<Query> &queries, std::ostream &out) {
+    std::unique_ptr<Engine> engine = info.create();
+    engine->set_queries(queries);
+
+    std::vector<std::vector<uint64_t>> times(BUCKET_COUNT);
+    std::vector<uint32_t> matches;
+    uint64_t match_count = 0, elapsed = 0;
+    size_t malformed = 0;
+    std::string error;
+
+    for (unsigned pass = 0; pass < REPLAY_WARMUP_PASSES + REPLAY_PASSES;
+         pass++) {
+        bool timed = pass >= REPLAY_WARMUP_PASSES;
+        for (const std::string &dump : dumps) {
+            uint64_t started = now_ns();
+            bool loaded = engine->load(dump.data(), dump.size(), error);
+            size_t found = 0;
+            for (size_t q = 0; loaded && q < queries.size(); q++) {
+                engine->run(q, matches);
+                found += matches.size();
+            }
+            uint64_t took = now_ns() - started;
+
+            if (pass == 0) {
+                match_count += found;
+                malformed += !loaded;
+            }
+            if (timed) {
+                times[bucket_of(dump.size())].push_back(took);
+                elapsed += took;
+            }
+        }
+    }
+
+    double bytes = 0;
+    for (const std::string &dump : dumps)
+        bytes += dump.size();
+    double seconds = elapsed / 1e9;
+
+    char line[160];
+    out << "Engine " << info.name << ": " << info.description << "\n";
+    snprintf(line, sizeof(line),
+             "  throughput: %.0f dumps/s, %.1f MB/s\n",
+             seconds ? dumps.size() * REPLAY_PASSES / seconds : 0.0,
+             seconds ? megabytes(bytes * REPLAY_PASSES) / seconds : 0.0);
+    out << line;
+    out << "  matches: " << match_count << ", malformed dumps: " << malformed
+        << "\n";
+    snprintf(line, sizeof(line), "  %-10s %8s %12s %12s\n", "size", "dumps",
+             "p50", "p99");
+    out << line;
+    for (size_t b = 0; b < BUCKET_COUNT; b++) {
+        std::vector<uint64_t> &samples = times[b];
+        if (samples.empty())
+            continue;
+        std::sort(samples.begin(), samples.end());
+        snprintf(line, sizeof(line), "  %-10s %8zu %9.1f us %9.1f us\n",
+                 BUCKETS[b].label, samples.size() / REPLAY_PASSES,
+                 percentile(samples, 0.50) / 1e3,
+                 percentile(samples, 0.99) / 1e3);
+        out << line;
+    }
+}
+
+} // namespace
+
+int replay_benchmark(const std::vector<std::string> &files,
+                     const std::string &query_file, std::ostream &out) {
+    std::vector<NamedQuery> named;
+    std::string error;
+    if (!load_queries(query_file, named, error)) {
+        std::cerr << "Error: " << error << "\n";
+        return 1;
+    }
+    std::vector<Query> queries;
+    for (const NamedQuery &query : named)
+        queries.push_back(query.query);
+
+    std::vector<std::string> dumps;
+    double bytes = 0;
+    for (const std::string &file : files) {
+        if (archive_kind(file) != ARCHIVE_NONE) {
+            std::cerr << "Error: --replay-bench reads plain dumps, not "
+                      << file << "\n";
+            return 1;
+        }
+        MappedFile input;
+        if (!input.open(file.c_str())) {
+            std::cerr << "Error: could not read file " << file << "\n";
+            return 1;
+        }
+        dumps.emplace_back(input.data(), input.size());
+        bytes += input.size();
+    }
+
+    struct rusage usage;
+    char line[160];
+    snprintf(line, sizeof(line),
+             "Replay of %zu dump(s), %.1f MB, with %zu query(ies), %u "
+             "timed pass(es)\n",
+             dumps.size(), megabytes(bytes), queries.size(), REPLAY_PASSES);
+    out << line;
+
+    // Each engine runs in a child of its own, so its peak memory is not
+    // hidden by the engines before it.
+    for (const EngineInfo &info : engines()) {
+        out.flush();
+        pid_t child = fork();
+        if (child == 0) {
+            replay_engine(info, dumps, queries, out);
+            out.flush();
+            _exit(0);
+        }
+
+        // In-process, the peak would include every engine run before and
+        // the dumps themselves, so it is not reported.
+        int status = 0;
+        if (child < 0 || wait4(child, &status, 0, &usage) != child) {
+            dprint("Running engine %s in-process\n", info.name);
+            replay_engine(info, dumps, queries, out);
+            out << "  peak RSS: n/a (run in-process)\n";
+            continue;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Error: engine " << info.name << " failed\n";
+            return 1;
+        }
+        snprintf(line, sizeof(line), "  peak RSS: %.1f MB\n",
+                 megabytes(peak_rss(usage)));
+        out << line;
+    }
+    return 0;
+}
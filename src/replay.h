@@ -0,0 +1,33 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_REPLAY_H
+#define UIDUMP_REPLAY_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Replays captured dumps through every engine, running all the queries
+// of query_file on each, and reports per engine the throughput, the
+// median and 99th percentile time per dump by dump size, and the peak
+// resident memory. The dumps are read into memory first so the disk is
+// not measured. Returns the process exit status.
+int replay_benchmark(const std::vector<std::string> &files,
+                     const std::string &query_file, std::ostream &out);
+
+#endif // UIDUMP_REPLAY_H
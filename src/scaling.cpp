@@ -0,0 +1,93 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scaling.h"
+
+#include <cstdio>
+
+#include "alloc_stats.h"
+
+ScalingSample ScalingSample::take(ProgressReporter &progress,
+                                  unsigned workers) {
+    ScalingSample sample = {};
+    auto add = [&](const WorkerCounters &counters) {
+        sample.files += counters.files.load(std::memory_order_relaxed);
+        sample.bytes += counters.bytes.load(std::memory_order_relaxed);
+        sample.read_ns += counters.read_ns.load(std::memory_order_relaxed);
+        sample.parse_ns += counters.parse_ns.load(std::memory_order_relaxed);
+    };
+    for (unsigned i = 0; i < workers; i++)
+        add(progress.worker(i));
+    add(progress.main_thread());
+    sample.merge_ns = progress.queue().merge_ns.load();
+    sample.allocations = alloc_stats().allocations;
+    return sample;
+}
+
+ScalingSample ScalingSample::operator-(const ScalingSample &before) const {
+    ScalingSample d;
+    d.files = files - before.files;
+    d.bytes = bytes - before.bytes;
+    d.read_ns = read_ns - before.read_ns;
+    d.parse_ns = parse_ns - before.parse_ns;
+    d.merge_ns = merge_ns - before.merge_ns;
+    d.allocations = allocations - before.allocations;
+    return d;
+}
+
+std::vector<unsigned> scaling_steps(unsigned max_jobs) {
+    std::vector<unsigned> steps;
+    for (unsigned jobs = 1; jobs < max_jobs; jobs *= 2)
+        steps.push_back(jobs);
+    steps.push_back(max_jobs ? max_jobs : 1);
+    return steps;
+}
+
+void print_scaling(std::ostream &out, const std::vector<ScalingRun> &runs) {
+    char line[200];
+    snprintf(line, sizeof(line),
+             "%5s %9s %9s %8s %6s %6s %6s %6s %6s %10s %11s\n", "jobs",
+             "files/s", "MB/s", "speedup", "eff", "read", "parse", "merge",
+             "idle", "parse/file", "allocs/file");
+    out << line;
+    if (runs.empty())
+        return;
+
+    double base = runs[0].wall_ns / 1e9;
+    for (const ScalingRun &run : runs) {
+        const ScalingSample &s = run.sample;
+        double seconds = run.wall_ns / 1e9;
+        double busy = (double)run.wall_ns * run.jobs;
+        double used = (double)s.read_ns + s.parse_ns;
+        double idle = busy > used ? busy - used : 0;
+        double files = s.files ? (double)s.files : 1;
+        double speedup = seconds ? base / seconds : 0;
+        auto share = [&](double ns) { return busy ? 100 * ns / busy : 0; };
+
+        snprintf(line, sizeof(line),
+                 "%5u %9.0f %9.2f %7.2fx %5.0f%% %5.0f%% %5.0f%% %5.0f%% "
+                 "%5.0f%% %7.1f us %11.1f\n",
+                 run.jobs, seconds ? s.files / seconds : 0.0,
+                 seconds ? s.bytes / seconds / (1024 * 1024) : 0.0, speedup,
+                 100 * speedup / run.jobs, share(s.read_ns),
+                 share(s.parse_ns),
+                 run.wall_ns ? 100.0 * s.merge_ns / run.wall_ns : 0.0,
+                 share(idle),
+                 s.parse_ns / files / 1e3, s.allocations / files);
+        out << line;
+    }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SCALING_H
+#define UIDUMP_SCALING_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "progress.h"
+
+// Where the time of one batch run went, summed over its threads.
+struct ScalingSample {
+    uint64_t files;
+    uint64_t bytes;
+    uint64_t read_ns;  // opening, extracting, prefiltering
+    uint64_t parse_ns; // parsing and searching
+    uint64_t merge_ns; // writing output out, on the calling thread
+    uint64_t allocations;
+
+    // Counters of every worker and the main thread, and the heap.
+    static ScalingSample take(ProgressReporter &progress, unsigned workers);
+    ScalingSample operator-(const ScalingSample &before) const;
+};
+
+struct ScalingRun {
+    unsigned jobs;
+    uint64_t wall_ns;
+    ScalingSample sample;
+};
+
+// 1, 2, 4, ... up to and including max_jobs.
+std::vector<unsigned> scaling_steps(unsigned max_jobs);
+
+// One row per run: speedup and efficiency against the first run, the
+// worker time spent reading, parsing and idle, the last being waits for
+// a free output slot, thread start-up and lock contention, and the share
+// of the run the calling thread spent writing output out beside them.
+// Parse time per file growing with the threads points at the allocator
+// or memory bandwidth.
+void print_scaling(std::ostream &out, const std::vector<ScalingRun> &runs);
+
+#endif // UIDUMP_SCALING_H
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "schema.h"
+
+#include <cstring>
+#include <string>
+
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+namespace {
+
+const char *const HIERARCHY_ATTRIBUTES[] = {"rotation"};
+
+const char *const NODE_ATTRIBUTES[] = {
+    "index",     "text",      "resource-id", "class",     "package",
+    "content-desc", "checkable", "checked",   "clickable", "enabled",
+    "focusable", "focused",   "scrollable",  "long-clickable",
+    "password",  "selected",  "bounds",
+};
+
+struct Kind {
+    const char *name;
+    const char *const *attributes;
+    unsigned attribute_count;
+};
+
+const Kind KINDS[SCHEMA_KINDS] = {
+    {"hierarchy", HIERARCHY_ATTRIBUTES, 1},
+    {"node", NODE_ATTRIBUTES,
+     sizeof(NODE_ATTRIBUTES) / sizeof(NODE_ATTRIBUTES[0])},
+};
+
+static_assert(sizeof(NODE_ATTRIBUTES) / sizeof(NODE_ATTRIBUTES[0]) <= 32,
+              "SchemaElement::encoded has a bit per attribute");
+
+// What each predicted attribute must start with, name included:
+// ` index="`, ` text="` and so on.
+struct Predictions {
+    std::string text[SCHEMA_KINDS][32];
+
+    Predictions() {
+        for (unsigned k = 0; k < SCHEMA_KINDS; k++) {
+            for (unsigned i = 0; i < KINDS[k].attribute_count; i++)
+                text[k][i] = std::string(" ") + KINDS[k].attributes[i] + "=\"";
+        }
+    }
+};
+
+const Predictions predictions;
+
+// Bytes that end the fast scan of a value: its closing quote, the end
+// of the buffer, and what means it must be decoded.
+struct ValueStops {
+    bool stop[256];
+
+    ValueStops() {
+        memset(stop, 0, sizeof(stop));
+        stop[(unsigned char)'"'] = stop[0] = true;
+        stop[(unsigned char)'&'] = stop[(unsigned char)'\r'] = true;
+    }
+};
+
+const ValueStops value_stops;
+
+// Padding after the dump, longer than any prediction or closing tag, so
+// they can be compared without checking for the end.
+const size_t PADDING = 64;
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+char *skip_space(char *p) {
+    while (is_space(*p))
+        ++p;
+    return p;
+}
+
+bool starts_with(const char *p, const char *prefix, size_t length) {
+    return memcmp(p, prefix, length) == 0;
+}
+
+} // namespace
+
+bool SchemaDump::parse(const char *xml, size_t size) {
+    elements_.clear();
+    values_.clear();
+    open_.clear();
+    if (size == 0 || size >= UINT32_MAX || memchr(xml, 0, size))
+        return false;
+    buffer_.resize(size + PADDING);
+    memcpy(buffer_.data(), xml, size);
+    memset(buffer_.data() + size, 0, PADDING);
+
+    char *base = buffer_.data();
+    char *p = skip_space(base);
+    if (starts_with(p, "<?", 2)) {
+        if (!(p = strstr(p + 2, "?>")))
+            return false;
+        p = skip_space(p + 2);
+    }
+    if (!starts_with(p, "<hierarchy", 10))
+        return false;
+    p += 10;
+    if (!parse_attributes(SCHEMA_HIERARCHY, p))
+        return false;
+
+    while (!open_.empty()) {
+        p = skip_space(p);
+        if (starts_with(p, "<node", 5)) {
+            p += 5;
+            // Leave room for the depth tinyxml2 counts at document level
+            // and for the children.
+            if (open_.size() + 2 >= (size_t)TINYXML2_MAX_ELEMENT_DEPTH ||
+                !parse_attributes(SCHEMA_NODE, p))
+                return false;
+            continue;
+        }
+        SchemaElement &open = elements_[open_.back()];
+        if (open.kind == SCHEMA_NODE && starts_with(p, "</node>", 7)) {
+            p += 7;
+        } else if (open.kind == SCHEMA_HIERARCHY &&
+                   starts_with(p, "</hierarchy>", 12)) {
+            p += 12;
+        } else {
+            return false;
+        }
+        open.end = elements_.size();
+        open_.pop_back();
+    }
+    return !*skip_space(p);
+}
+
+// Reads the attributes and the end of a start tag, with p just past the
+// element name. Any deviation from the schema fails.
+bool SchemaDump::parse_attributes(unsigned kind, char *&p) {
+    const Kind &schema = KINDS[kind];
+    SchemaElement element;
+    element.kind = kind;
+    element.first_value = values_.size();
+    element.encoded = 0;
+    element.end = elements_.size() + 1;
+
+    char *base = buffer_.data();
+    for (unsigned i = 0; i < schema.attribute_count; i++) {
+        const std::string &prediction = predictions.text[kind][i];
+        if (!starts_with(p, prediction.data(), prediction.size()))
+            return false;
+        p += prediction.size();
+
+        SchemaValue value;
+        value.offset = p - base;
+        for (;;) {
+            while (!value_stops.stop[(unsigned char)*p])
+                ++p;
+            if (*p == '"')
+                break;
+            if (!*p)
+                return false;
+            element.encoded |= 1u << i;
+            ++p;
+        }
+        value.length = p - base - value.offset;
+        values_.push_back(value);
+        ++p;
+    }
+
+    if (*p == '>') {
+        open_.push_back(elements_.size());
+        ++p;
+    } else if (starts_with(p, " />", 3)) {
+        p += 3;
+    } else if (starts_with(p, "/>", 2)) {
+        p += 2;
+    } else {
+        return false;
+    }
+    elements_.push_back(element);
+    return true;
+}
+
+int SchemaDump::slot(unsigned kind, const char *name) {
+    const Kind &schema = KINDS[kind];
+    for (unsigned i = 0; i < schema.attribute_count; i++) {
+        if (strcmp(schema.attributes[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char *SchemaDump::value(uint32_t i, unsigned slot, size_t &length) {
+    SchemaElement &element = elements_[i];
+    SchemaValue &value = values_[element.first_value + slot];
+    char *start = &buffer_[value.offset];
+    if (element.encoded & (1u << slot)) {
+        // Decodes in place, as XMLAttribute::Value() would.
+        StrPair pair;
+        pair.Set(start, start + value.length, StrPair::ATTRIBUTE_VALUE);
+        value.length = strlen(pair.GetStr());
+        element.encoded &= ~(1u << slot);
+    }
+    length = value.length;
+    return start;
+}
+
+void SchemaDump::print(uint32_t i, std::ostream &out) {
+    const Kind &schema = KINDS[elements_[i].kind];
+    out << "Node: " << schema.name << "\n";
+    for (unsigned slot = 0; slot < schema.attribute_count; slot++) {
+        size_t length;
+        const char *v = value(i, slot, length);
+        out << "  " << schema.attributes[slot] << ": ";
+        out.write(v, length) << "\n";
+    }
+    out << "\n";
+}
+
+void schema_slots(const QueryProgram &program, unsigned kind,
+                  int8_t *slots) {
+    for (unsigned reg = 0; reg < program.register_count; reg++)
+        slots[reg] = SchemaDump::slot(kind, program.register_name(reg));
+}
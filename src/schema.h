@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SCHEMA_H
+#define UIDUMP_SCHEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "query.h"
+
+// The elements uiautomator writes, each with its attributes in the
+// order uiautomator always writes them.
+enum SchemaKind { SCHEMA_HIERARCHY, SCHEMA_NODE, SCHEMA_KINDS };
+
+struct SchemaValue {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SchemaElement {
+    uint32_t kind;
+    uint32_t first_value; // one value per attribute of the kind, in order
+    uint32_t encoded;     // bit per attribute holding entities or \r
+    uint32_t end; // one past the ordinal of the last element inside it
+};
+
+// A uiautomator dump parsed against its schema. Instead of reading each
+// attribute name, the parser predicts it from the element kind and the
+// attribute before it and checks the prediction, with the space, the
+// equals sign and the opening quote, in one memcmp. Values land in the
+// element's slots; they are decoded the first time they are read.
+//
+// Anything else uiautomator would not write, such as another attribute
+// order, single quotes, comments or text, fails parse(), and the dump
+// must go to tinyxml2 instead.
+class SchemaDump {
+  public:
+    bool parse(const char *xml, size_t size);
+
+    size_t size() const { return elements_.size(); }
+    const SchemaElement &element(uint32_t i) const { return elements_[i]; }
+
+    // Which attribute of kind is called name, or -1.
+    static int slot(unsigned kind, const char *name);
+
+    // The decoded value of element i's attribute in slot.
+    const char *value(uint32_t i, unsigned slot, size_t &length);
+
+    // Prints element i as print_node_attributes() prints an element.
+    void print(uint32_t i, std::ostream &out);
+
+  private:
+    bool parse_attributes(unsigned kind, char *&p);
+
+    std::vector<char> buffer_;
+    std::vector<SchemaElement> elements_;
+    std::vector<SchemaValue> values_;
+    std::vector<uint32_t> open_; // elements whose closing tag is pending
+};
+
+// Maps each register of program to its slot in elements of kind, -1 for
+// attributes the kind does not have.
+void schema_slots(const QueryProgram &program, unsigned kind, int8_t *slots);
+
+// Register loader for run_query() over one element of a schema dump,
+// with slots from schema_slots() for the element's kind.
+struct SchemaAttributes {
+    SchemaDump &dump;
+    uint32_t element;
+    const int8_t *slots;
+
+    bool get(unsigned reg, const char *&value, size_t &length) {
+        if (slots[reg] < 0)
+            return false;
+        value = dump.value(element, slots[reg], length);
+        return true;
+    }
+};
+
+#endif // UIDUMP_SCHEMA_H
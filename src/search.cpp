@@ -0,0 +1,186 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "search.h"
+
+#include <cstring>
+
+#include "debug.h"
+#include "tape.h"
+
+using namespace tinyxml2;
+
+thread_local TopK *top_matches = nullptr;
+
+const char *const LOW_CARDINALITY_ATTRIBUTES[] = {
+    "class",     "package",        "checkable", "checked",
+    "clickable", "enabled",        "focusable", "focused",
+    "scrollable", "long-clickable", "password", "selected",
+    nullptr,
+};
+
+void print_node_attributes(std::ostream &out, const XMLElement *element,
+                           const char *only_print) {
+    dprint("Processing node: %s\n", element->Name());
+
+    if (only_print && strlen(only_print) > 0) {
+        const char *attr = element->Attribute(only_print);
+        if (attr) {
+            out << only_print << ": " << attr << "\n";
+        } else {
+            out << "Attribute '" << only_print << "' not found on node "
+                << element->Name() << "\n";
+        }
+        return;
+    }
+
+    out << "Node: " << element->Name() << "\n";
+    bool hasAttributes = false;
+
+    for (const XMLAttribute *attr = element->FirstAttribute(); attr;
+         attr = attr->Next()) {
+        hasAttributes = true;
+        out << "  " << attr->Name() << ": " << attr->Value() << "\n";
+    }
+
+    if (!hasAttributes) {
+        out << "  No attributes found for node: " << element->Name() << "\n";
+    }
+
+    out << "\n";
+}
+
+void report_match(std::ostream &out, const XMLElement *element,
+                  const char *only_print) {
+    if (top_matches)
+        top_matches->offer(element);
+    else
+        print_node_attributes(out, element, only_print);
+}
+
+bool node_matches_additional_filter(const XMLElement *element,
+                                    const std::string &filter_attribute,
+                                    const std::string &filter_value) {
+    if (!filter_attribute.empty() && !filter_value.empty()) {
+        const char *attr_value = element->Attribute(filter_attribute.c_str());
+        return attr_value && filter_value == attr_value;
+    }
+    return true;
+}
+
+void find_node_by_resource_id(std::ostream &out, const XMLElement *element,
+                              const std::string &resource_id,
+                              const char *only_print,
+                              const std::string &filter_attribute,
+                              const std::string &filter_value) {
+    const char *res_id_attr = element->Attribute("resource-id");
+
+    if (res_id_attr && resource_id == res_id_attr) {
+        if (node_matches_additional_filter(element, filter_attribute,
+                                           filter_value)) {
+            report_match(out, element, only_print);
+        }
+    }
+
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        find_node_by_resource_id(out, child, resource_id, only_print,
+                                 filter_attribute, filter_value);
+    }
+}
+
+void find_node_by_class(std::ostream &out, const XMLElement *element,
+                        const std::string &class_name, const char *only_print,
+                        const std::string &filter_attribute,
+                        const std::string &filter_value,
+                        const char *interned_class) {
+    const char *class_attr = element->Attribute("class");
+    if (class_attr && (interned_class ? class_attr == interned_class
+                                      : class_name == class_attr)) {
+        if (node_matches_additional_filter(element, filter_attribute,
+                                           filter_value)) {
+            report_match(out, element, only_print);
+        }
+    }
+
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        find_node_by_class(out, child, class_name, only_print,
+                           filter_attribute, filter_value, interned_class);
+    }
+}
+
+void find_node_by_text(std::ostream &out, const XMLElement *element,
+                       const std::string &text_value, const char *only_print,
+                       const std::string &filter_attribute,
+                       const std::string &filter_value) {
+    const char *text_attr = element->Attribute("text");
+    if (text_attr && text_value == text_attr) {
+        if (node_matches_additional_filter(element, filter_attribute,
+                                           filter_value)) {
+            report_match(out, element, only_print);
+        }
+    }
+
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        find_node_by_text(out, child, text_value, only_print,
+                          filter_attribute, filter_value);
+    }
+}
+
+void find_node_by_query(std::ostream &out, const XMLElement *element,
+                        const QueryProgram &query, const char *only_print,
+                        const std::string &filter_attribute,
+                        const std::string &filter_value,
+                        const QueryInterning *interning) {
+    if (query_matches(query, element, interning) &&
+        node_matches_additional_filter(element, filter_attribute,
+                                       filter_value)) {
+        report_match(out, element, only_print);
+    }
+
+    for (const XMLElement *child = element->FirstChildElement();
+         child != nullptr; child = child->NextSiblingElement()) {
+        find_node_by_query(out, child, query, only_print,
+                           filter_attribute, filter_value, interning);
+    }
+}
+
+void find_node_by_query(std::ostream &out, Tape &tape,
+                        const QueryProgram &query, const char *only_print) {
+    for (uint32_t i = 0; i < tape.size(); i++) {
+        TapeAttributes attributes = {query, tape, tape.element(i)};
+        if (run_query(query, attributes))
+            tape.print(i, out, only_print);
+    }
+}
+
+void find_node_by_filter(std::ostream &out, const XMLElement *element,
+                         const std::string &filter_attribute,
+                         const std::string &filter_value,
+                         const char *only_print) {
+    for (const XMLElement *child = element; child != nullptr;
+         child = child->NextSiblingElement()) {
+        if (node_matches_additional_filter(child, filter_attribute,
+                                           filter_value)) {
+            report_match(out, child, only_print);
+        }
+        find_node_by_filter(out, child->FirstChildElement(), filter_attribute,
+                            filter_value, only_print);
+    }
+}
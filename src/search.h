@@ -0,0 +1,97 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SEARCH_H
+#define UIDUMP_SEARCH_H
+
+#include <ostream>
+#include <string>
+
+#include "order.h"
+#include "query.h"
+#include "tinyxml2/tinyxml2.h"
+
+class Tape;
+
+// When set, the search functions hand their matches to it instead of
+// printing them, so only the best ones are printed at the end. Each
+// worker thread points it at its own ranking.
+extern thread_local TopK *top_matches;
+
+// Attributes whose handful of distinct values repeat across a dump's
+// nodes, which a search comparing them for equality has the document
+// intern. Null terminated.
+extern const char *const LOW_CARDINALITY_ATTRIBUTES[];
+
+void print_node_attributes(std::ostream &out,
+                           const tinyxml2::XMLElement *element,
+                           const char *only_print);
+
+// Prints the match, or hands it to top_matches.
+void report_match(std::ostream &out, const tinyxml2::XMLElement *element,
+                  const char *only_print);
+
+bool node_matches_additional_filter(const tinyxml2::XMLElement *element,
+                                    const std::string &filter_attribute,
+                                    const std::string &filter_value);
+
+// The finders below walk the tree under element and report every node
+// that matches, and also carries filter_value in filter_attribute when
+// those are given.
+void find_node_by_resource_id(std::ostream &out,
+                              const tinyxml2::XMLElement *element,
+                              const std::string &resource_id,
+                              const char *only_print,
+                              const std::string &filter_attribute = "",
+                              const std::string &filter_value = "");
+
+// interned_class, when given, is the document's interned copy of
+// class_name, and class values are compared with it by pointer.
+void find_node_by_class(std::ostream &out,
+                        const tinyxml2::XMLElement *element,
+                        const std::string &class_name, const char *only_print,
+                        const std::string &filter_attribute = "",
+                        const std::string &filter_value = "",
+                        const char *interned_class = nullptr);
+
+void find_node_by_text(std::ostream &out, const tinyxml2::XMLElement *element,
+                       const std::string &text_value, const char *only_print,
+                       const std::string &filter_attribute = "",
+                       const std::string &filter_value = "");
+
+// With interning, from a QueryInterner for element's document, its
+// equality tests on interned attributes compare pointers.
+void find_node_by_query(std::ostream &out,
+                        const tinyxml2::XMLElement *element,
+                        const QueryProgram &query, const char *only_print,
+                        const std::string &filter_attribute = "",
+                        const std::string &filter_value = "",
+                        const QueryInterning *interning = nullptr);
+
+// The same search over a dump parsed onto a tape, for runs that neither
+// rank nor filter their matches.
+void find_node_by_query(std::ostream &out, Tape &tape,
+                        const QueryProgram &query, const char *only_print);
+
+// Walks element and its following siblings.
+void find_node_by_filter(std::ostream &out,
+                         const tinyxml2::XMLElement *element,
+                         const std::string &filter_attribute,
+                         const std::string &filter_value,
+                         const char *only_print);
+
+#endif // UIDUMP_SEARCH_H
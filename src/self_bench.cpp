@@ -0,0 +1,149 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "self_bench.h"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
+
+#include "benchmark.h"
+#include "query.h"
+#include "search.h"
+#include "synthetic.h"
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+// Kept short so a run over adb takes about a second even on old phones.
+static const unsigned SELF_BENCH_SAMPLES = 10;
+static const double SELF_BENCH_SAMPLE_MS = 20;
+
+static const char *target_abi() {
+#if defined(__aarch64__)
+    return "arm64-v8a";
+#elif defined(__arm__)
+    return "armeabi-v7a";
+#elif defined(__x86_64__)
+    return "x86_64";
+#elif defined(__i386__)
+    return "x86";
+#else
+    return "unknown";
+#endif
+}
+
+// The device model with spaces replaced, so the line splits on them.
+static std::string device_model() {
+    std::string model = "host";
+#ifdef __ANDROID__
+    char value[PROP_VALUE_MAX] = "";
+    if (__system_property_get("ro.product.model", value) > 0)
+        model = value;
+#endif
+    for (char &c : model) {
+        if (c == ' ' || c == '=')
+            c = '_';
+    }
+    return model;
+}
+
+static void print_field(std::ostream &out, const char *name, double value,
+                        const char *unit, double ci_percent) {
+    char field[96];
+    snprintf(field, sizeof(field), " %s=%.1f%s(+-%.0f%%)", name, value, unit,
+             ci_percent);
+    out << field;
+}
+
+static BenchResult time_it(const std::function<void()> &fn) {
+    return run_benchmark(
+        [&](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i)
+                fn();
+        },
+        SELF_BENCH_SAMPLES, SELF_BENCH_SAMPLE_MS);
+}
+
+// Throughput in MB/s of an operation over size bytes.
+static void print_throughput(std::ostream &out, const char *name,
+                             const BenchResult &r, size_t size) {
+    print_field(out, name, size * 1e3 / r.ns_per_op, "MB/s",
+                100 * r.ci95 / r.ns_per_op);
+}
+
+static void print_latency(std::ostream &out, const char *name,
+                          const BenchResult &r) {
+    print_field(out, name, r.ns_per_op / 1e3, "us",
+                100 * r.ci95 / r.ns_per_op);
+}
+
+void self_benchmark(std::ostream &out) {
+    // A typical screen, and a heavy one: long entity-laden texts inside
+    // deep nesting, as WebViews produce.
+    SyntheticSpec small_spec;
+    std::string small = synthetic_dump(small_spec);
+    SyntheticSpec large_spec;
+    large_spec.rows = 200;
+    large_spec.nesting = 30;
+    large_spec.text_length = 200;
+    large_spec.entities = true;
+    std::string large = synthetic_dump(large_spec);
+
+    XMLDocument eager;
+    BenchResult parse_small =
+        time_it([&] { eager.Parse(small.c_str(), small.size()); });
+    BenchResult parse_large =
+        time_it([&] { eager.Parse(large.c_str(), large.size()); });
+
+    // Searches parse attributes lazily, so the queries run on a document
+    // parsed that way, which is also timed.
+    XMLDocument doc;
+    doc.SetLazyAttributes(true);
+    BenchResult parse_small_lazy =
+        time_it([&] { doc.Parse(small.c_str(), small.size()); });
+    BenchResult parse_large_lazy =
+        time_it([&] { doc.Parse(large.c_str(), large.size()); });
+
+    Query query;
+    std::string error;
+    query.compile("class=android.widget.TextView && text~Item", error);
+    QueryProgram program = query.program();
+    std::ostream discard(nullptr);
+    const XMLElement *root = doc.RootElement();
+    BenchResult query_large = time_it(
+        [&] { find_node_by_query(discard, root, program, nullptr); });
+    BenchResult find_large = time_it([&] {
+        find_node_by_resource_id(discard, root, "com.example.app:id/price",
+                                 nullptr);
+    });
+
+    out << "self-bench 2 abi=" << target_abi() << " model=" << device_model()
+        << " cores=" << std::thread::hardware_concurrency();
+    print_throughput(out, "parse_small", parse_small, small.size());
+    print_throughput(out, "parse_large", parse_large, large.size());
+    print_throughput(out, "parse_small_lazy", parse_small_lazy, small.size());
+    print_throughput(out, "parse_large_lazy", parse_large_lazy, large.size());
+    print_latency(out, "query_large", query_large);
+    print_latency(out, "find_id_large", find_large);
+    out << "\n";
+}
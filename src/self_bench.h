@@ -0,0 +1,34 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SELF_BENCH_H
+#define UIDUMP_SELF_BENCH_H
+
+#include <ostream>
+
+// Benchmarks parsing and querying on dumps generated in memory, so it
+// runs anywhere the binary does, storage untouched, and prints one line
+// that identifies the device and can be collected across a fleet:
+//
+//   self-bench 2 abi=arm64-v8a model=Pixel_6 cores=8 parse_small=...
+//
+// Parsing is timed both eagerly and with lazy attributes, as searches
+// parse. Each figure is followed by its 95% confidence interval in
+// percent.
+void self_benchmark(std::ostream &out);
+
+#endif // UIDUMP_SELF_BENCH_H
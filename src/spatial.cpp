@@ -0,0 +1,182 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spatial.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace tinyxml2;
+
+bool parse_direction(const char *name, Direction &out) {
+    static const struct {
+        const char *name;
+        Direction direction;
+    } directions[] = {
+        {"any", DIRECTION_ANY},           {"right-of", DIRECTION_RIGHT_OF},
+        {"left-of", DIRECTION_LEFT_OF},   {"below", DIRECTION_BELOW},
+        {"above", DIRECTION_ABOVE},
+    };
+    for (const auto &d : directions) {
+        if (strcmp(name, d.name) == 0) {
+            out = d.direction;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int center_on(const Bounds &b, int axis) {
+    return axis == 0 ? b.center_x() : b.center_y();
+}
+
+static long long center_distance_squared(const Bounds &a, const Bounds &b) {
+    long long dx = a.center_x() - b.center_x();
+    long long dy = a.center_y() - b.center_y();
+    return dx * dx + dy * dy;
+}
+
+// Whether a rectangle lies in the requested direction from the anchor.
+static bool in_direction(const Bounds &anchor, const Bounds &b,
+                         Direction direction) {
+    switch (direction) {
+    case DIRECTION_RIGHT_OF:
+        return b.left >= anchor.right;
+    case DIRECTION_LEFT_OF:
+        return b.right <= anchor.left;
+    case DIRECTION_BELOW:
+        return b.top >= anchor.bottom;
+    case DIRECTION_ABOVE:
+        return b.bottom <= anchor.top;
+    default:
+        return true;
+    }
+}
+
+// Whether any rectangle inside the extent could lie in that direction.
+static bool extent_reaches(const Bounds &anchor, const Bounds &extent,
+                           Direction direction) {
+    switch (direction) {
+    case DIRECTION_RIGHT_OF:
+        return extent.right >= anchor.right;
+    case DIRECTION_LEFT_OF:
+        return extent.left <= anchor.left;
+    case DIRECTION_BELOW:
+        return extent.bottom >= anchor.bottom;
+    case DIRECTION_ABOVE:
+        return extent.top <= anchor.top;
+    default:
+        return true;
+    }
+}
+
+static bool hit_less(const SpatialHit &a, const SpatialHit &b) {
+    if (a.gap != b.gap)
+        return a.gap < b.gap;
+    return a.center < b.center;
+}
+
+SpatialIndex::SpatialIndex(const std::vector<SpatialEntry> &entries)
+    : entries_(entries), extent_(entries.size()) {
+    build(0, entries_.size(), 0);
+}
+
+void SpatialIndex::build(size_t lo, size_t hi, int depth) {
+    if (lo >= hi)
+        return;
+    int axis = depth & 1;
+    size_t mid = lo + (hi - lo) / 2;
+    std::nth_element(entries_.begin() + lo, entries_.begin() + mid,
+                     entries_.begin() + hi,
+                     [axis](const SpatialEntry &a, const SpatialEntry &b) {
+                         return center_on(a.bounds, axis) <
+                                center_on(b.bounds, axis);
+                     });
+    build(lo, mid, depth + 1);
+    build(mid + 1, hi, depth + 1);
+
+    Bounds extent = entries_[mid].bounds;
+    if (mid > lo) {
+        const Bounds &l = extent_[lo + (mid - lo) / 2];
+        extent.left = std::min(extent.left, l.left);
+        extent.top = std::min(extent.top, l.top);
+        extent.right = std::max(extent.right, l.right);
+        extent.bottom = std::max(extent.bottom, l.bottom);
+    }
+    if (hi > mid + 1) {
+        const Bounds &r = extent_[mid + 1 + (hi - mid - 1) / 2];
+        extent.left = std::min(extent.left, r.left);
+        extent.top = std::min(extent.top, r.top);
+        extent.right = std::max(extent.right, r.right);
+        extent.bottom = std::max(extent.bottom, r.bottom);
+    }
+    extent_[mid] = extent;
+}
+
+void SpatialIndex::nearest(const SpatialEntry &anchor, size_t k,
+                           Direction direction,
+                           std::vector<SpatialHit> &out) const {
+    out.clear();
+    if (k == 0)
+        return;
+    // out doubles as a max-heap on (gap, center) while searching.
+    search(0, entries_.size(), 0, anchor, k, direction, out);
+    std::sort_heap(out.begin(), out.end(), hit_less);
+}
+
+void SpatialIndex::search(size_t lo, size_t hi, int depth,
+                          const SpatialEntry &anchor, size_t k,
+                          Direction direction,
+                          std::vector<SpatialHit> &heap) const {
+    if (lo >= hi)
+        return;
+    size_t mid = lo + (hi - lo) / 2;
+    const Bounds &extent = extent_[mid];
+    if (!extent_reaches(anchor.bounds, extent, direction))
+        return;
+    if (heap.size() == k &&
+        bounds_gap_squared(anchor.bounds, extent) > heap.front().gap)
+        return;
+
+    const SpatialEntry &entry = entries_[mid];
+    if (entry.element != anchor.element &&
+        in_direction(anchor.bounds, entry.bounds, direction)) {
+        SpatialHit hit = {&entry,
+                          bounds_gap_squared(anchor.bounds, entry.bounds),
+                          center_distance_squared(anchor.bounds,
+                                                  entry.bounds)};
+        if (heap.size() < k) {
+            heap.push_back(hit);
+            std::push_heap(heap.begin(), heap.end(), hit_less);
+        } else if (hit_less(hit, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), hit_less);
+            heap.back() = hit;
+            std::push_heap(heap.begin(), heap.end(), hit_less);
+        }
+    }
+
+    // Descend into the half containing the anchor's center first so the
+    // heap tightens before the far half is considered.
+    int axis = depth & 1;
+    if (center_on(anchor.bounds, axis) < center_on(entry.bounds, axis)) {
+        search(lo, mid, depth + 1, anchor, k, direction, heap);
+        search(mid + 1, hi, depth + 1, anchor, k, direction, heap);
+    } else {
+        search(mid + 1, hi, depth + 1, anchor, k, direction, heap);
+        search(lo, mid, depth + 1, anchor, k, direction, heap);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SPATIAL_H
+#define UIDUMP_SPATIAL_H
+
+#include <cstddef>
+#include <vector>
+
+#include "bounds.h"
+
+enum Direction {
+    DIRECTION_ANY,
+    DIRECTION_RIGHT_OF,
+    DIRECTION_LEFT_OF,
+    DIRECTION_BELOW,
+    DIRECTION_ABOVE,
+};
+
+bool parse_direction(const char *name, Direction &out);
+
+struct SpatialEntry {
+    const tinyxml2::XMLElement *element;
+    Bounds bounds;
+};
+
+struct SpatialHit {
+    const SpatialEntry *entry;
+    long long gap;    // squared gap between the rectangles
+    long long center; // squared distance between centers, breaks ties
+};
+
+// Static 2-d tree over node rectangles. Entries are split on their
+// centers; every subtree also keeps the union of its rectangles so whole
+// branches can be skipped once they cannot beat the current k-th hit.
+class SpatialIndex {
+  public:
+    explicit SpatialIndex(const std::vector<SpatialEntry> &entries);
+
+    // Fills out with up to k entries closest to anchor, nearest first.
+    // The anchor element itself is never reported.
+    void nearest(const SpatialEntry &anchor, size_t k, Direction direction,
+                 std::vector<SpatialHit> &out) const;
+
+    size_t size() const { return entries_.size(); }
+
+  private:
+    void build(size_t lo, size_t hi, int depth);
+    void search(size_t lo, size_t hi, int depth, const SpatialEntry &anchor,
+                size_t k, Direction direction,
+                std::vector<SpatialHit> &heap) const;
+
+    std::vector<SpatialEntry> entries_;
+    std::vector<Bounds> extent_; // subtree rectangle union, at its median
+};
+
+#endif // UIDUMP_SPATIAL_H
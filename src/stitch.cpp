@@ -0,0 +1,98 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stitch.h"
+
+#include <cstring>
+
+using namespace tinyxml2;
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t hash_bytes(uint64_t h, const char *s) {
+    for (; *s; ++s) {
+        h ^= (unsigned char)*s;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static uint64_t hash_byte(uint64_t h, unsigned char c) {
+    h ^= c;
+    return h * FNV_PRIME;
+}
+
+// Attributes that change while a list scrolls without the row changing.
+static bool is_positional(const char *name) {
+    return strcmp(name, "bounds") == 0 || strcmp(name, "index") == 0 ||
+           strcmp(name, "focused") == 0 || strcmp(name, "selected") == 0;
+}
+
+static uint64_t hash_subtree(uint64_t h, const XMLElement *element) {
+    h = hash_byte(h, '<');
+    for (const XMLAttribute *attr = element->FirstAttribute(); attr;
+         attr = attr->Next()) {
+        if (is_positional(attr->Name()))
+            continue;
+        h = hash_bytes(h, attr->Name());
+        h = hash_byte(h, '=');
+        h = hash_bytes(h, attr->Value());
+        h = hash_byte(h, 0);
+    }
+    for (const XMLElement *child = element->FirstChildElement(); child;
+         child = child->NextSiblingElement()) {
+        h = hash_subtree(h, child);
+    }
+    return hash_byte(h, '>');
+}
+
+uint64_t item_subtree_hash(const XMLElement *item) {
+    return hash_subtree(FNV_OFFSET, item);
+}
+
+size_t ListStitcher::add(const std::vector<const XMLElement *> &items) {
+    current_.resize(items.size());
+    for (size_t i = 0; i < items.size(); i++)
+        current_[i] = item_subtree_hash(items[i]);
+
+    // Knuth-Morris-Pratt with the new dump as the pattern: after running
+    // over the previous dump, the matched length is the longest prefix of
+    // the new list that is also a suffix of the old one.
+    failure_.assign(current_.size(), 0);
+    for (size_t i = 1, k = 0; i < current_.size(); i++) {
+        while (k > 0 && current_[i] != current_[k])
+            k = failure_[k - 1];
+        if (current_[i] == current_[k])
+            k++;
+        failure_[i] = k;
+    }
+
+    size_t matched = 0;
+    for (size_t i = 0; i < previous_.size() && !current_.empty(); i++) {
+        while (matched > 0 &&
+               (matched == current_.size() ||
+                previous_[i] != current_[matched]))
+            matched = failure_[matched - 1];
+        if (previous_[i] == current_[matched])
+            matched++;
+    }
+
+    total_ += current_.size() - matched;
+    previous_.swap(current_);
+    return matched;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_STITCH_H
+#define UIDUMP_STITCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tinyxml2/tinyxml2.h"
+
+// Hash of an item's subtree that ignores where it sits on screen, so the
+// same list row hashes identically before and after a scroll.
+uint64_t item_subtree_hash(const tinyxml2::XMLElement *item);
+
+// Joins the item lists of consecutive, overlapping dumps of the same
+// scrolling container into one virtual list.
+class ListStitcher {
+  public:
+    // Returns how many leading items of this dump were already emitted as
+    // the tail of the previous one; the rest are new.
+    size_t add(const std::vector<const tinyxml2::XMLElement *> &items);
+
+    size_t total() const { return total_; }
+
+  private:
+    std::vector<uint64_t> previous_;
+    std::vector<uint64_t> current_;
+    std::vector<size_t> failure_;
+    size_t total_ = 0;
+};
+
+#endif // UIDUMP_STITCH_H
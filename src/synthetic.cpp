@@ -0,0 +1,151 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "synthetic.h"
+
+#include <random>
+#include <string>
+
+namespace {
+
+struct NodeSpec {
+    const char *text;
+    const char *resource_id;
+    const char *class_name;
+    const char *content_desc;
+    bool clickable;
+    int left, top, right, bottom;
+};
+
+class DumpWriter {
+  public:
+    explicit DumpWriter(std::string &out) : out_(out) {}
+
+    void open(unsigned index, const NodeSpec &node, unsigned depth,
+              bool leaf) {
+        out_.append(depth * 2, ' ');
+        out_ += "<node index=\"";
+        out_ += std::to_string(index);
+        out_ += "\" text=\"";
+        out_ += node.text;
+        out_ += "\" resource-id=\"";
+        out_ += node.resource_id;
+        out_ += "\" class=\"";
+        out_ += node.class_name;
+        out_ += "\" package=\"com.example.app\" content-desc=\"";
+        out_ += node.content_desc;
+        out_ += "\" checkable=\"false\" checked=\"false\" clickable=\"";
+        out_ += node.clickable ? "true" : "false";
+        out_ += "\" enabled=\"true\" focusable=\"";
+        out_ += node.clickable ? "true" : "false";
+        out_ += "\" focused=\"false\" scrollable=\"false\" "
+                "long-clickable=\"false\" password=\"false\" "
+                "selected=\"false\" bounds=\"[";
+        out_ += std::to_string(node.left);
+        out_ += ',';
+        out_ += std::to_string(node.top);
+        out_ += "][";
+        out_ += std::to_string(node.right);
+        out_ += ',';
+        out_ += std::to_string(node.bottom);
+        out_ += leaf ? "]\" />\n" : "]\">\n";
+    }
+
+    void close(unsigned depth) {
+        out_.append(depth * 2, ' ');
+        out_ += "</node>\n";
+    }
+
+  private:
+    std::string &out_;
+};
+
+} // namespace
+
+std::string synthetic_dump(const SyntheticSpec &spec) {
+    std::minstd_rand rng(spec.seed);
+    std::string out;
+    out.reserve(1024 + spec.rows * (1400 + 3 * spec.text_length));
+    out += "<?xml version='1.0' encoding='UTF-8' standalone='yes' ?>\n"
+           "<hierarchy rotation=\"0\">\n";
+    DumpWriter writer(out);
+
+    const int width = 1080;
+    const int height = 400 + 200 * static_cast<int>(spec.rows);
+    unsigned depth = 1;
+    writer.open(0, {"", "", "android.widget.FrameLayout", "", false, 0, 0,
+                    width, height},
+                depth++, false);
+
+    writer.open(0, {"", "com.example.app:id/form",
+                    "android.widget.LinearLayout", "", false, 0, 100, width,
+                    300},
+                depth, false);
+    writer.open(0, {"Email", "com.example.app:id/email_label",
+                    "android.widget.TextView", "", false, 40, 120, 240, 180},
+                depth + 1, true);
+    writer.open(1, {"", "com.example.app:id/email",
+                    "android.widget.EditText", "Email", true, 260, 110, 1040,
+                    190},
+                depth + 1, true);
+    writer.close(depth);
+
+    for (unsigned i = 0; i < spec.nesting; ++i)
+        writer.open(i ? 0 : 1, {"", "", "android.widget.LinearLayout", "",
+                                false, 0, 400, width, height},
+                    depth++, false);
+    writer.open(spec.nesting ? 0 : 1,
+                {"", "com.example.app:id/list",
+                 "androidx.recyclerview.widget.RecyclerView", "", false, 0,
+                 400, width, height},
+                depth++, false);
+
+    std::string title, price;
+    for (unsigned i = 0; i < spec.rows; ++i) {
+        unsigned item = rng() % 10000;
+        int y = 400 + 200 * static_cast<int>(i);
+        title = "Item " + std::to_string(item);
+        title += spec.entities ? " &amp; &quot;more&quot; &lt;new&gt;"
+                               : " and more";
+        while (title.size() < spec.text_length)
+            title += spec.entities ? " &#233;t&#233;" : " lorem ipsum";
+        price = "$" + std::to_string(rng() % 1000) + ".99";
+
+        writer.open(i, {"", "com.example.app:id/row",
+                        "android.widget.LinearLayout", "", true, 0, y, width,
+                        y + 200},
+                    depth, false);
+        writer.open(0, {title.c_str(), "com.example.app:id/title",
+                        "android.widget.TextView", "", false, 40, y + 20, 700,
+                        y + 100},
+                    depth + 1, true);
+        writer.open(1, {price.c_str(), "com.example.app:id/price",
+                        "android.widget.TextView", "", false, 740, y + 20,
+                        1040, y + 100},
+                    depth + 1, true);
+        writer.open(2, {"", "com.example.app:id/icon",
+                        "android.widget.ImageView", "Add to cart", true, 40,
+                        y + 110, 120, y + 190},
+                    depth + 1, true);
+        writer.close(depth);
+    }
+
+    while (depth > 1)
+        writer.close(--depth);
+    out += "</hierarchy>\n";
+    return out;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_SYNTHETIC_H
+#define UIDUMP_SYNTHETIC_H
+
+#include <string>
+
+// Shape of a generated uiautomator dump: a form above a list whose rows
+// hold a title, a price and an icon, the way most of our screens look.
+struct SyntheticSpec {
+    unsigned rows = 8;
+    unsigned nesting = 0;     // extra layouts wrapped around the list
+    unsigned text_length = 0; // pad titles to at least this many bytes
+    bool entities = false;    // put escaped characters in the text
+    unsigned seed = 1;        // varies the texts and the bounds
+};
+
+// Returns a dump in the format uiautomator writes, every node with the
+// full attribute set in uiautomator's order.
+std::string synthetic_dump(const SyntheticSpec &spec);
+
+#endif // UIDUMP_SYNTHETIC_H
@@ -0,0 +1,362 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tape.h"
+
+#include <cstring>
+
+#include "tinyxml2/tinyxml2.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+using namespace tinyxml2;
+
+static const char STRUCTURAL[] = {'<', '>', '"', '\'', '=', '/', '&', '\r'};
+
+enum {
+    STRUCTURAL_CHAR = 1,
+    WHITE_SPACE_CHAR = 2,
+    NAME_START_CHAR = 4,
+    NAME_CHAR = 8,
+};
+
+// XMLUtil's character tests, which go through the C locale, as one
+// table lookup.
+struct CharClasses {
+    uint8_t bits[256];
+
+    CharClasses() {
+        for (unsigned c = 0; c < 256; c++) {
+            bits[c] = 0;
+            if (XMLUtil::IsWhiteSpace((char)c))
+                bits[c] |= WHITE_SPACE_CHAR;
+            if (XMLUtil::IsNameStartChar(c))
+                bits[c] |= NAME_START_CHAR;
+            if (XMLUtil::IsNameChar(c))
+                bits[c] |= NAME_CHAR;
+        }
+        for (char c : STRUCTURAL)
+            bits[(unsigned char)c] |= STRUCTURAL_CHAR;
+    }
+};
+
+static const CharClasses char_classes;
+
+static inline uint8_t char_class(char c) {
+    return char_classes.bits[(unsigned char)c];
+}
+
+#if defined(__SSE2__)
+
+static uint64_t structural_mask(const char *p) {
+    __m128i block = _mm_loadu_si128((const __m128i *)p);
+    __m128i eq = _mm_setzero_si128();
+    for (char c : STRUCTURAL)
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(block, _mm_set1_epi8(c)));
+    return (uint32_t)_mm_movemask_epi8(eq);
+}
+
+#define HAVE_SIMD_STRUCTURAL 1
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static uint64_t structural_mask(const char *p) {
+    static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                        1, 2, 4, 8, 16, 32, 64, 128};
+    uint8x16_t block = vld1q_u8((const uint8_t *)p);
+    uint8x16_t eq = vdupq_n_u8(0);
+    for (char c : STRUCTURAL)
+        eq = vorrq_u8(eq, vceqq_u8(block, vdupq_n_u8((uint8_t)c)));
+    // Same movemask emulation as find_bytes().
+    uint8x16_t bits = vandq_u8(eq, vld1q_u8(weights));
+    uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    return vget_lane_u8(sum, 0) | ((uint32_t)vget_lane_u8(sum, 1) << 8);
+}
+
+#define HAVE_SIMD_STRUCTURAL 1
+
+#endif
+
+void structural_index(const char *data, size_t blocks, uint64_t *bits) {
+#ifdef HAVE_SIMD_STRUCTURAL
+    for (size_t b = 0; b < blocks; b++, data += 64) {
+        bits[b] = structural_mask(data) | structural_mask(data + 16) << 16 |
+                  structural_mask(data + 32) << 32 |
+                  structural_mask(data + 48) << 48;
+    }
+#else
+    for (size_t b = 0; b < blocks; b++, data += 64) {
+        uint64_t mask = 0;
+        for (unsigned i = 0; i < 64; i++) {
+            if (char_class(data[i]) & STRUCTURAL_CHAR)
+                mask |= 1ULL << i;
+        }
+        bits[b] = mask;
+    }
+#endif
+}
+
+// Offset of the first marked byte at or after from, or the end of the
+// index when there is none.
+static size_t next_structural(const std::vector<uint64_t> &index,
+                              size_t from) {
+    size_t word = from / 64;
+    if (word >= index.size())
+        return index.size() * 64;
+    uint64_t mask = index[word] & (~0ULL << (from % 64));
+    while (!mask) {
+        if (++word == index.size())
+            return index.size() * 64;
+        mask = index[word];
+    }
+    return word * 64 + __builtin_ctzll(mask);
+}
+
+static char *skip_white_space(char *p) {
+    while (char_class(*p) & WHITE_SPACE_CHAR)
+        ++p;
+    return p;
+}
+
+static char *skip_name(char *p) {
+    while (char_class(*p) & NAME_CHAR)
+        ++p;
+    return p;
+}
+
+// Spreads attribute names over 64 bits so a repeated name can be ruled
+// out without comparing it to every earlier one.
+static uint64_t name_bit(const char *name, size_t length) {
+    unsigned h = (unsigned)length * 7 + (unsigned char)name[0] * 3 +
+                 (unsigned char)name[length - 1];
+    return 1ULL << (h % 64);
+}
+
+bool Tape::parse(const char *xml, size_t size) {
+    elements_.clear();
+    attributes_.clear();
+    open_.clear();
+    // tinyxml2 stops at a NUL, and the offsets are 32 bits.
+    if (size == 0 || size >= UINT32_MAX || memchr(xml, 0, size))
+        return false;
+
+    // Whole blocks, with at least one NUL after the dump to stop scans.
+    size_t blocks = size / 64 + 1;
+    buffer_.resize(blocks * 64);
+    memcpy(buffer_.data(), xml, size);
+    memset(buffer_.data() + size, 0, buffer_.size() - size);
+    index_.resize(blocks);
+    structural_index(buffer_.data(), blocks, index_.data());
+    return parse_tags(size);
+}
+
+// Mirrors what XMLDocument::Parse() accepts for the markup it covers,
+// so a dump only fails here when tinyxml2 must look at it.
+bool Tape::parse_tags(size_t size) {
+    char *base = buffer_.data();
+    char *end = base + size;
+    char *p = skip_white_space(base);
+    if (strncmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+
+    bool prolog = true; // nothing but declarations so far
+    for (;;) {
+        p = skip_white_space(p);
+        if (!*p)
+            break;
+        if (*p++ != '<')
+            return false;
+
+        if (*p == '?') {
+            // Declarations must come before anything else.
+            if (!prolog || !(p = strstr(p + 1, "?>")))
+                return false;
+            p += 2;
+            continue;
+        }
+        prolog = false;
+
+        if (*p == '!') {
+            if (strncmp(p, "!--", 3) != 0 || !(p = strstr(p + 3, "-->")))
+                return false;
+            p += 3;
+            continue;
+        }
+
+        if (*p == '/') {
+            if (open_.empty())
+                return false;
+            TapeElement &open = elements_[open_.back()];
+            ++p;
+            if ((size_t)(end - p) < open.name_length ||
+                memcmp(p, base + open.name, open.name_length) != 0)
+                return false;
+            p = skip_white_space(p + open.name_length);
+            if (*p++ != '>')
+                return false;
+            open.end = elements_.size();
+            open_.pop_back();
+            continue;
+        }
+
+        if (!(char_class(*p) & NAME_START_CHAR))
+            return false;
+        TapeElement element;
+        element.name = p - base;
+        p = skip_name(p);
+        element.name_length = p - base - element.name;
+        element.first_attribute = attributes_.size();
+        element.attribute_count = 0;
+        element.end = elements_.size() + 1;
+
+        uint64_t names = 0;
+        for (;;) {
+            p = skip_white_space(p);
+            if (*p == '>') {
+                // Leave room for the depth tinyxml2 counts at document
+                // level and for the children.
+                if (open_.size() + 2 >= (size_t)TINYXML2_MAX_ELEMENT_DEPTH)
+                    return false;
+                open_.push_back(elements_.size());
+                ++p;
+                break;
+            }
+            if (*p == '/' && p[1] == '>') {
+                p += 2;
+                break;
+            }
+            if (!(char_class(*p) & NAME_START_CHAR))
+                return false;
+
+            TapeAttribute attribute;
+            attribute.name = p - base;
+            p = skip_name(p);
+            size_t name_length = p - base - attribute.name;
+            if (name_length > UINT16_MAX)
+                return false;
+            attribute.name_length = name_length;
+            p = skip_white_space(p);
+            if (*p++ != '=')
+                return false;
+            p = skip_white_space(p);
+            char quote = *p++;
+            if (quote != '"' && quote != '\'')
+                return false;
+
+            // The closing quote is the first marked quote byte; the marks
+            // passed on the way say whether the value needs decoding.
+            attribute.value = p - base;
+            attribute.encoded = 0;
+            attribute.pad = 0;
+            for (;;) {
+                p = base + next_structural(index_, p - base);
+                if (p >= end)
+                    return false;
+                if (*p == quote)
+                    break;
+                if (*p == '&' || *p == '\r')
+                    attribute.encoded = 1;
+                ++p;
+            }
+            attribute.value_length = p - base - attribute.value;
+            ++p;
+
+            const char *name = base + attribute.name;
+            uint64_t bit = name_bit(name, name_length);
+            if (names & bit) {
+                for (size_t i = element.first_attribute;
+                     i < attributes_.size(); i++) {
+                    if (attributes_[i].name_length == name_length &&
+                        memcmp(base + attributes_[i].name, name,
+                               name_length) == 0)
+                        return false;
+                }
+            }
+            names |= bit;
+            attributes_.push_back(attribute);
+            element.attribute_count++;
+        }
+        elements_.push_back(element);
+    }
+    return open_.empty() && !elements_.empty();
+}
+
+long Tape::find(const TapeElement &element, const char *name,
+                size_t length) const {
+    const TapeAttribute *attribute = &attributes_[element.first_attribute];
+    for (uint32_t i = 0; i < element.attribute_count; i++, attribute++) {
+        if (attribute->name_length == length &&
+            memcmp(&buffer_[attribute->name], name, length) == 0)
+            return element.first_attribute + i;
+    }
+    return -1;
+}
+
+const char *Tape::value(uint32_t i, size_t &length) {
+    TapeAttribute &attribute = attributes_[i];
+    char *start = &buffer_[attribute.value];
+    if (attribute.encoded) {
+        // Decodes in place, as XMLAttribute::Value() would.
+        StrPair pair;
+        pair.Set(start, start + attribute.value_length,
+                 StrPair::ATTRIBUTE_VALUE);
+        attribute.value_length = strlen(pair.GetStr());
+        attribute.encoded = 0;
+    }
+    length = attribute.value_length;
+    return start;
+}
+
+void Tape::print(uint32_t i, std::ostream &out, const char *only_print) {
+    const TapeElement &element = elements_[i];
+    const char *name = text(element.name);
+    if (only_print && *only_print) {
+        long k = find(element, only_print, strlen(only_print));
+        if (k >= 0) {
+            size_t length;
+            const char *v = value((uint32_t)k, length);
+            out << only_print << ": ";
+            out.write(v, length) << "\n";
+        } else {
+            out << "Attribute '" << only_print << "' not found on node ";
+            out.write(name, element.name_length) << "\n";
+        }
+        return;
+    }
+    out << "Node: ";
+    out.write(name, element.name_length) << "\n";
+    for (uint32_t a = 0; a < element.attribute_count; a++) {
+        uint32_t k = element.first_attribute + a;
+        size_t length;
+        const char *v = value(k, length);
+        out << "  ";
+        out.write(text(attributes_[k].name), attributes_[k].name_length);
+        out << ": ";
+        out.write(v, length) << "\n";
+    }
+    if (element.attribute_count == 0) {
+        out << "  No attributes found for node: ";
+        out.write(name, element.name_length) << "\n";
+    }
+    out << "\n";
+}
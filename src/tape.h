@@ -0,0 +1,107 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_TAPE_H
+#define UIDUMP_TAPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "query.h"
+
+// Sets bit i of bits[i / 64] when data[i] is one of < > " ' = / & or \r,
+// for blocks * 64 bytes of data. Uses SSE2 or NEON where available.
+void structural_index(const char *data, size_t blocks, uint64_t *bits);
+
+// One element of a tape. Offsets point into the tape's copy of the dump.
+struct TapeElement {
+    uint32_t name;
+    uint32_t name_length;
+    uint32_t first_attribute;
+    uint32_t attribute_count;
+    uint32_t end; // one past the ordinal of the last element inside it
+};
+
+struct TapeAttribute {
+    uint32_t name;
+    uint32_t value;
+    uint32_t value_length;
+    uint16_t name_length;
+    uint8_t encoded; // holds entities or \r and is still undecoded
+    uint8_t pad;
+};
+
+// A dump flattened into arrays instead of a tree, parsed in two stages:
+// a SIMD pass marks the bytes markup is built from, then a single pass
+// walks the marks to find each tag and the end of each quoted value.
+// Elements are numbered in document order, so a query is one loop over
+// them. Values are decoded the first time they are read.
+//
+// The tape covers what uiautomator writes: elements, attributes,
+// comments and a leading declaration, with only whitespace between
+// tags. parse() returns false for anything else, such as text content,
+// CDATA or a doctype, and for malformed dumps, which tinyxml2 must then
+// judge.
+class Tape {
+  public:
+    bool parse(const char *xml, size_t size);
+
+    size_t size() const { return elements_.size(); }
+    const TapeElement &element(uint32_t i) const { return elements_[i]; }
+    const TapeAttribute &attribute(uint32_t i) const { return attributes_[i]; }
+    const char *text(uint32_t offset) const { return &buffer_[offset]; }
+
+    // Index of element's attribute called name, or -1.
+    long find(const TapeElement &element, const char *name,
+              size_t length) const;
+
+    // The decoded value of attribute i.
+    const char *value(uint32_t i, size_t &length);
+
+    // Prints element i as print_node_attributes() prints an element.
+    void print(uint32_t i, std::ostream &out,
+               const char *only_print = nullptr);
+
+  private:
+    bool parse_tags(size_t size);
+
+    std::vector<char> buffer_;
+    std::vector<uint64_t> index_;
+    std::vector<TapeElement> elements_;
+    std::vector<TapeAttribute> attributes_;
+    std::vector<uint32_t> open_; // elements whose closing tag is pending
+};
+
+// Register loader for run_query() over one element of a tape.
+struct TapeAttributes {
+    const QueryProgram &program;
+    Tape &tape;
+    const TapeElement &element;
+
+    bool get(unsigned reg, const char *&value, size_t &length) {
+        const QueryString &name = program.registers[reg];
+        long i = tape.find(element, program.string(name), name.length);
+        if (i < 0)
+            return false;
+        value = tape.value((uint32_t)i, length);
+        return true;
+    }
+};
+
+#endif // UIDUMP_TAPE_H
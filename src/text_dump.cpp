@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "text_dump.h"
+
+#include <cstring>
+
+#include "radix.h"
+
+using namespace tinyxml2;
+
+static bool bounds_contain(const Bounds &outer, const Bounds &inner) {
+    return outer.left <= inner.left && outer.top <= inner.top &&
+           outer.right >= inner.right && outer.bottom >= inner.bottom;
+}
+
+void collect_text_blocks(const XMLElement *root, std::vector<TextBlock> &out) {
+    size_t first_descendant = out.size();
+    for (const XMLElement *child = root->FirstChildElement(); child != nullptr;
+         child = child->NextSiblingElement()) {
+        collect_text_blocks(child, out);
+    }
+
+    TextBlock block;
+    if (!element_bounds(root, block.bounds) || block.bounds.area() <= 0)
+        return;
+    // A container's own label would span all the lines it holds.
+    for (size_t i = first_descendant; i < out.size(); i++) {
+        if (bounds_contain(block.bounds, out[i].bounds))
+            return;
+    }
+
+    const char *text = root->Attribute("text");
+    const char *desc = root->Attribute("content-desc");
+    std::vector<TextBlock>::iterator at = out.begin() + first_descendant;
+    if (desc && *desc && !(text && strcmp(text, desc) == 0)) {
+        block.text = desc;
+        at = out.insert(at, block);
+    }
+    if (text && *text) {
+        block.text = text;
+        out.insert(at, block);
+    }
+}
+
+void reading_order(const std::vector<TextBlock> &blocks,
+                   std::vector<std::vector<uint32_t>> &lines) {
+    lines.clear();
+
+    std::vector<uint32_t> keys(blocks.size());
+    std::vector<uint32_t> order(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) {
+        keys[i] = radix_key(blocks[i].bounds.top);
+        order[i] = i;
+    }
+    radix_sort_by_key(keys, order);
+
+    // Blocks are compared with the shortest block of the line rather than
+    // with the union of the line so far, so one tall block cannot chain
+    // every line below it into its own.
+    const Bounds *anchor = nullptr;
+    for (uint32_t index : order) {
+        const Bounds &b = blocks[index].bounds;
+        if (!anchor || !intervals_aligned(anchor->top, anchor->bottom, b.top,
+                                          b.bottom)) {
+            lines.push_back(std::vector<uint32_t>());
+            anchor = &b;
+        } else if (b.height() < anchor->height()) {
+            anchor = &b;
+        }
+        lines.back().push_back(index);
+    }
+
+    for (size_t i = 0; i < blocks.size(); i++)
+        keys[i] = radix_key(blocks[i].bounds.left);
+    for (std::vector<uint32_t> &line : lines) {
+        if (line.size() > 1)
+            radix_sort_by_key(keys, line);
+    }
+}
+
+void print_text_dump(const XMLElement *root, std::ostream &out) {
+    std::vector<TextBlock> blocks;
+    std::vector<std::vector<uint32_t>> lines;
+    collect_text_blocks(root, blocks);
+    reading_order(blocks, lines);
+
+    for (const std::vector<uint32_t> &line : lines) {
+        for (size_t i = 0; i < line.size(); i++) {
+            if (i)
+                out << "  ";
+            out << blocks[line[i]].text;
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UIDUMP_TEXT_DUMP_H
+#define UIDUMP_TEXT_DUMP_H
+
+#include <ostream>
+#include <vector>
+
+#include "bounds.h"
+
+struct TextBlock {
+    const char *text;
+    Bounds bounds;
+};
+
+// Gathers every non-empty text and content-desc value on screen along
+// with the bounds of the node carrying it. Nodes whose bounds contain a
+// block of their subtree are containers and their own values are left
+// out.
+void collect_text_blocks(const tinyxml2::XMLElement *root,
+                         std::vector<TextBlock> &out);
+
+// Orders blocks for reading: a block joins the current line when its
+// vertical extent overlaps the line's shortest block by at least half the
+// shorter one, lines run top to bottom and blocks within a line left to
+// right. Each inner vector is one line.
+void reading_order(const std::vector<TextBlock> &blocks,
+                   std::vector<std::vector<uint32_t>> &lines);
+
+void print_text_dump(const tinyxml2::XMLElement *root, std::ostream &out);
+
+#endif // UIDUMP_TEXT_DUMP_H
@@ -133,6 +133,8 @@ static const unsigned char TIXML_UTF_LEAD_2 = 0xbfU;
 namespace tinyxml2
 {
 
+MemPoolHooks memPoolHooks = { 0, 0 };
+
 struct Entity {
     const char* pattern;
     int length;
@@ -1606,7 +1608,9 @@ void XMLAttribute::SetAttribute( float v )
 // --------- XMLElement ---------- //
 XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
     _closingType( OPEN ),
-    _rootAttribute( 0 )
+    _rootAttribute( 0 ),
+    _unparsedAttributes( 0 ),
+    _unparsedLineNum( 0 )
 {
 }
 
@@ -1628,6 +1632,9 @@ const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
             return a;
         }
     }
+    if ( _unparsedAttributes ) {
+        return const_cast<XMLElement*>( this )->ParseLazyAttributes( name );
+    }
     return 0;
 }
 
@@ -1919,6 +1926,9 @@ float XMLElement::FloatText(float defaultValue) const
 
 XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
+    if ( _unparsedAttributes ) {
+        ParseLazyAttributes( 0 );
+    }
     XMLAttribute* last = 0;
     XMLAttribute* attrib = 0;
     for( attrib = _rootAttribute;
@@ -1947,6 +1957,9 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 
 void XMLElement::DeleteAttribute( const char* name )
 {
+    if ( _unparsedAttributes ) {
+        ParseLazyAttributes( 0 );
+    }
     XMLAttribute* prev = 0;
     for( XMLAttribute* a=_rootAttribute; a; a=a->_next ) {
         if ( XMLUtil::StringEqual( name, a->Name() ) ) {
@@ -1966,6 +1979,9 @@ void XMLElement::DeleteAttribute( const char* name )
 
 char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
 {
+    if ( _document->LazyAttributes() ) {
+        return ParseAttributeSpan( p, curLineNumPtr );
+    }
     XMLAttribute* prevAttribute = 0;
 
     // Read the attributes.
@@ -1990,6 +2006,7 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
                 return 0;
             }
+            InternValue( attrib );
             // There is a minor bug here: if the attribute in the source xml
             // document is duplicated, it will not be detected and the
             // attribute will be doubly added. However, tracking the 'prevAttribute'
@@ -2023,6 +2040,110 @@ char* XMLElement::ParseAttributes( char* p, int* curLineNumPtr )
     return p;
 }
 
+// Checks the attributes the way ParseAttributes() does, without
+// creating any, and remembers where the first one starts.
+char* XMLElement::ParseAttributeSpan( char* p, int* curLineNumPtr )
+{
+    p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+    if ( XMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+        _unparsedAttributes = p;
+        _unparsedLineNum = *curLineNumPtr;
+    }
+
+    while ( XMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+        const int attrLineNum = *curLineNumPtr;
+        ++p;
+        while ( *p && XMLUtil::IsNameChar( (unsigned char) *p ) ) {
+            ++p;
+        }
+        p = XMLUtil::SkipWhiteSpace( p, curLineNumPtr );
+        bool valid = false;
+        if ( *p == '=' ) {
+            p = XMLUtil::SkipWhiteSpace( p + 1, curLineNumPtr );
+            if ( *p == '\"' || *p == '\'' ) {
+                const char quote = *p;
+                for ( ++p; *p && *p != quote; ++p ) {
+                    if ( *p == '\n' ) {
+                        ++(*curLineNumPtr);
+                    }
+                }
+                valid = *p != 0;
+            }
+        }
+        if ( !valid ) {
+            _unparsedAttributes = 0;
+            _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, attrLineNum, "XMLElement name=%s", Name() );
+            return 0;
+        }
+        p = XMLUtil::SkipWhiteSpace( p + 1, curLineNumPtr );
+    }
+
+    if ( *p == '>' ) {
+        return p + 1;
+    }
+    if ( *p == '/' && *(p+1) == '>' ) {
+        _closingType = CLOSED;
+        return p + 2;
+    }
+    _unparsedAttributes = 0;
+    if ( !*p ) {
+        _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, "XMLElement name=%s", Name() );
+    }
+    else {
+        _document->SetError( XML_ERROR_PARSING_ELEMENT, _parseLineNum, 0 );
+    }
+    return 0;
+}
+
+
+// Adds attributes from the recorded span until one is called name, or
+// until the span is used up when name is null, returning that one.
+XMLAttribute* XMLElement::ParseLazyAttributes( const char* name )
+{
+    XMLAttribute* last = _rootAttribute;
+    while ( last && last->_next ) {
+        last = last->_next;
+    }
+
+    char* p = _unparsedAttributes;
+    int lineNum = _unparsedLineNum;
+    while ( XMLUtil::IsNameStartChar( (unsigned char) *p ) ) {
+        XMLAttribute* attrib = CreateAttribute();
+        TIXMLASSERT( attrib );
+        attrib->_parseLineNum = lineNum;
+        p = attrib->ParseDeep( p, _document->ProcessEntities(), &lineNum );
+        // ParseAttributeSpan() has checked the syntax.
+        TIXMLASSERT( p );
+        InternValue( attrib );
+        if ( last ) {
+            last->_next = attrib;
+        }
+        else {
+            _rootAttribute = attrib;
+        }
+        last = attrib;
+        p = XMLUtil::SkipWhiteSpace( p, &lineNum );
+
+        if ( name && XMLUtil::StringEqual( attrib->Name(), name ) ) {
+            _unparsedAttributes = XMLUtil::IsNameStartChar( (unsigned char) *p ) ? p : 0;
+            _unparsedLineNum = lineNum;
+            return attrib;
+        }
+    }
+    _unparsedAttributes = 0;
+    return 0;
+}
+
+
+// Shares attrib's value with equal ones when the document interns it.
+void XMLElement::InternValue( XMLAttribute* attrib )
+{
+    if ( _document->InternsAttribute( attrib->Name() ) ) {
+        attrib->_value.SetInternedStr( _document->Intern( attrib->Value(), false ) );
+    }
+}
+
+
 void XMLElement::DeleteAttribute( XMLAttribute* attribute )
 {
     if ( attribute == 0 ) {
@@ -2151,7 +2272,7 @@ bool XMLElement::ShallowEqual( const XMLNode* compare ) const
 bool XMLElement::Accept( XMLVisitor* visitor ) const
 {
     TIXMLASSERT( visitor );
-    if ( visitor->VisitEnter( *this, _rootAttribute ) ) {
+    if ( visitor->VisitEnter( *this, FirstAttribute() ) ) {
         for ( const XMLNode* node=FirstChild(); node; node=node->NextSibling() ) {
             if ( !node->Accept( visitor ) ) {
                 break;
@@ -2192,6 +2313,12 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
     _processEntities( processEntities ),
+    _lazyAttributes( false ),
+    _internedNames( 0 ),
+    _internTable( 0 ),
+    _internCapacity( 0 ),
+    _internCount( 0 ),
+    _internCopies(),
     _errorID(XML_SUCCESS),
     _whitespaceMode( whitespaceMode ),
     _errorStr(),
@@ -2213,6 +2340,7 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
 XMLDocument::~XMLDocument()
 {
     Clear();
+    delete [] _internTable;
 }
 
 
@@ -2245,6 +2373,17 @@ void XMLDocument::Clear()
     _charBuffer = 0;
 	_parsingDepth = 0;
 
+    // The interned values point into the buffer; keep the table's
+    // storage for the next parse.
+    if ( _internCount ) {
+        memset( _internTable, 0, _internCapacity * sizeof( *_internTable ) );
+        _internCount = 0;
+    }
+    for ( size_t i = 0; i < _internCopies.Size(); ++i ) {
+        delete [] _internCopies[i];
+    }
+    _internCopies.Clear();
+
 #if 0
     _textPool.Trace( "text" );
     _elementPool.Trace( "element" );
@@ -2495,6 +2634,66 @@ void XMLDocument::Print( XMLPrinter* streamer ) const
 }
 
 
+bool XMLDocument::InternsAttribute( const char* name ) const
+{
+    if ( !_internedNames ) {
+        return false;
+    }
+    for ( const char* const* n = _internedNames; *n; ++n ) {
+        if ( **n == *name && strcmp( *n, name ) == 0 ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Finds value in the table, adding it, or a copy of it when copy is
+// set, when it is not there yet.
+const char* XMLDocument::Intern( const char* value, bool copy )
+{
+    if ( ( _internCount + 1 ) * 2 > _internCapacity ) {
+        const size_t capacity = _internCapacity ? _internCapacity * 2 : 64;
+        const char** table = new const char*[capacity];
+        memset( table, 0, capacity * sizeof( *table ) );
+        const char** old = _internTable;
+        const size_t oldCapacity = _internCapacity;
+        _internTable = table;
+        _internCapacity = capacity;
+        _internCount = 0;
+        for ( size_t i = 0; i < oldCapacity; ++i ) {
+            if ( old[i] ) {
+                Intern( old[i], false );
+            }
+        }
+        delete [] old;
+    }
+
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    size_t length = 0;
+    for ( const char* p = value; *p; ++p, ++length ) {
+        hash = ( hash ^ static_cast<unsigned char>( *p ) ) * 16777619u;
+    }
+    size_t i = hash & ( _internCapacity - 1 );
+    while ( _internTable[i] ) {
+        if ( strcmp( _internTable[i], value ) == 0 ) {
+            return _internTable[i];
+        }
+        i = ( i + 1 ) & ( _internCapacity - 1 );
+    }
+    if ( copy ) {
+        char* mine = new char[length + 1];
+        memcpy( mine, value, length + 1 );
+        _internCopies.Push( mine );
+        value = mine;
+    }
+    _internTable[i] = value;
+    ++_internCount;
+    return value;
+}
+
+
 void XMLDocument::ClearError() {
     _errorID = XML_SUCCESS;
     _errorLineNum = 0;
@@ -336,6 +336,19 @@ public:
 };
 
 
+/*
+	Optional accounting callbacks shared by every MemPoolT; each is
+	skipped while null. itemAlloc runs for every item handed out and
+	blockAlloc for every block a pool grows by.
+*/
+struct MemPoolHooks {
+    void (*itemAlloc)( size_t itemSize );
+    void (*blockAlloc)( size_t blockSize );
+};
+
+extern TINYXML2_LIB MemPoolHooks memPoolHooks;
+
+
 /*
 	Template child class to create pools of the correct type.
 */
@@ -373,6 +386,9 @@ public:
             // Need a new block.
             Block* block = new Block;
             _blockPtrs.Push( block );
+            if ( memPoolHooks.blockAlloc ) {
+                memPoolHooks.blockAlloc( sizeof( Block ) );
+            }
 
             Item* blockItems = block->items;
             for( size_t i = 0; i < ITEMS_PER_BLOCK - 1; ++i ) {
@@ -391,6 +407,9 @@ public:
         }
         ++_nAllocs;
         ++_nUntracked;
+        if ( memPoolHooks.itemAlloc ) {
+            memPoolHooks.itemAlloc( ITEM_SIZE );
+        }
         return result;
     }
 
@@ -1514,6 +1533,9 @@ public:
 
     /// Return the first attribute in the list.
     const XMLAttribute* FirstAttribute() const {
+        if ( _unparsedAttributes ) {
+            const_cast<XMLElement*>( this )->ParseLazyAttributes( 0 );
+        }
         return _rootAttribute;
     }
     /// Query a specific attribute in the list.
@@ -1692,6 +1714,9 @@ private:
 
     XMLAttribute* FindOrCreateAttribute( const char* name );
     char* ParseAttributes( char* p, int* curLineNumPtr );
+    char* ParseAttributeSpan( char* p, int* curLineNumPtr );
+    XMLAttribute* ParseLazyAttributes( const char* name );
+    void InternValue( XMLAttribute* attrib );
     static void DeleteAttribute( XMLAttribute* attribute );
     XMLAttribute* CreateAttribute();
 
@@ -1701,6 +1726,10 @@ private:
     // because the list needs to be scanned for dupes before adding
     // a new attribute.
     XMLAttribute* _rootAttribute;
+    // With lazy attributes, the first attribute not yet in the list
+    // and its line, or null once all are.
+    char* _unparsedAttributes;
+    int _unparsedLineNum;
 };
 
 
@@ -1795,6 +1824,46 @@ public:
         return _whitespaceMode;
     }
 
+    /**
+    	With lazy attributes, parsing only checks the syntax of each
+    	start tag and remembers where its attributes are. They are
+    	tokenized the first time they are looked at, FindAttribute()
+    	stopping at the one it was asked for, so attributes nobody
+    	reads never become XMLAttributes. Duplicate attributes are not
+    	detected, and as reads now change the DOM, a document parsed
+    	this way must not be read from several threads at once. Takes
+    	effect at the next Parse() or Load.
+    */
+    void SetLazyAttributes( bool lazy ) {
+        _lazyAttributes = lazy;
+    }
+    bool LazyAttributes() const {
+        return _lazyAttributes;
+    }
+
+    /**
+    	Interns the values of the attributes called names, a null
+    	terminated list that must outlive the document's parses. As
+    	such an attribute is parsed, its value is looked up in a table
+    	of the document's distinct values, and an equal one already
+    	there is shared, so a value looked up once with InternValue()
+    	can then be compared with them by pointer. Takes effect at the
+    	next Parse() or Load; null stops interning.
+    */
+    void SetInternedAttributes( const char* const* names ) {
+        _internedNames = names;
+    }
+    /// Whether values of attributes called name are interned.
+    bool InternsAttribute( const char* name ) const;
+    /**
+    	Returns the document's interned copy of value, adding a copy
+    	when no interned attribute holds it yet. It stays valid until
+    	the document is cleared.
+    */
+    const char* InternValue( const char* value ) {
+        return Intern( value, true );
+    }
+
     /**
     	Returns true if this document has a leading Byte Order Mark of UTF8.
     */
@@ -1936,6 +2005,14 @@ private:
 
     bool			_writeBOM;
     bool			_processEntities;
+    bool			_lazyAttributes;
+    const char* const* _internedNames;
+    // Open-addressed hash table of distinct interned values, with
+    // the copies InternValue() made for values not in the document.
+    const char**	_internTable;
+    size_t			_internCapacity;
+    size_t			_internCount;
+    DynArray<char*, 4> _internCopies;
     XMLError		_errorID;
     Whitespace		_whitespaceMode;
     mutable StrPair	_errorStr;
@@ -1960,6 +2037,8 @@ private:
 
     void Parse();
 
+    const char* Intern( const char* value, bool copy );
+
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
 	// Something of an obvious security hole, once it was discovered.
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2024 Roger Ortiz (R0r1z2)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks of the layout, screen ranking and --order-by code on small
+// dumps whose right answer is known, such as a full-screen container
+// carrying a content-desc or a grid under a full-width header. Each
+// failure prints what was expected and what came out. Build and run
+// with `make check`.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "grid.h"
+#include "identify.h"
+#include "order.h"
+#include "text_dump.h"
+#include "tinyxml2/tinyxml2.h"
+
+using namespace tinyxml2;
+
+namespace {
+
+// Prints the children of the root's first node as a --grid table would.
+void print_child_grid(const XMLElement *root, std::ostream &out) {
+    const XMLElement *container = root->FirstChildElement();
+    std::vector<GridCell> cells;
+    for (const XMLElement *child =
+             container ? container->FirstChildElement() : nullptr;
+         child != nullptr; child = child->NextSiblingElement()) {
+        GridCell cell;
+        cell.element = child;
+        if (element_bounds(child, cell.bounds) && cell.bounds.area() > 0)
+            cells.push_back(cell);
+    }
+    unsigned rows, columns;
+    layout_grid(cells, rows, columns);
+    print_grid(out, cells, rows, columns, std::vector<std::string>(1, "text"));
+}
+
+struct LayoutCase {
+    const char *name;
+    void (*render)(const XMLElement *root, std::ostream &out);
+    const char *xml;
+    const char *expected;
+};
+
+const LayoutCase LAYOUT_CASES[] = {
+    {"text dump of a described full-screen container", print_text_dump,
+     "<hierarchy rotation=\"0\">"
+     "<node text=\"\" content-desc=\"Main screen\" "
+     "bounds=\"[0,0][1080,1920]\">"
+     "<node text=\"Title\" bounds=\"[0,100][1080,200]\"/>"
+     "<node text=\"Left\" bounds=\"[0,900][540,1000]\"/>"
+     "<node text=\"Right\" bounds=\"[540,900][1080,1000]\"/>"
+     "<node text=\"Footer\" bounds=\"[0,1800][1080,1900]\"/>"
+     "</node></hierarchy>",
+     "Title\n"
+     "Left  Right\n"
+     "Footer\n"},
+    {"text dump beside a tall image", print_text_dump,
+     "<hierarchy rotation=\"0\">"
+     "<node content-desc=\"Avatar\" bounds=\"[0,100][200,400]\"/>"
+     "<node text=\"Name\" bounds=\"[220,100][1000,180]\"/>"
+     "<node text=\"Status\" bounds=\"[220,200][1000,280]\"/>"
+     "<node text=\"Seen\" bounds=\"[220,320][1000,400]\"/>"
+     "</hierarchy>",
+     "Avatar  Name\n"
+     "Status\n"
+     "Seen\n"},
+    {"text dump of a button labelling its own text", print_text_dump,
+     "<hierarchy rotation=\"0\">"
+     "<node content-desc=\"Send\" bounds=\"[0,0][300,100]\">"
+     "<node text=\"Send now\" bounds=\"[20,20][280,80]\"/>"
+     "</node>"
+     "<node text=\"Cancel\" content-desc=\"Cancel button\" "
+     "bounds=\"[400,0][700,100]\"/>"
+     "</hierarchy>",
+     "Send now  Cancel  Cancel button\n"},
+    {"grid under a full-width header", print_child_grid,
+     "<hierarchy rotation=\"0\">"
+     "<node class=\"android.widget.GridLayout\" bounds=\"[0,0][1000,300]\">"
+     "<node text=\"Header\" bounds=\"[0,0][1000,100]\"/>"
+     "<node text=\"A\" bounds=\"[0,100][500,200]\"/>"
+     "<node text=\"B\" bounds=\"[500,100][1000,200]\"/>"
+     "<node text=\"C\" bounds=\"[0,200][500,300]\"/>"
+     "<node text=\"D\" bounds=\"[500,200][1000,300]\"/>"
+     "</node></hierarchy>",
+     "Header\t\n"
+     "A\tB\n"
+     "C\tD\n"},
+    {"grid with a cell spanning two rows", print_child_grid,
+     "<hierarchy rotation=\"0\">"
+     "<node class=\"android.widget.GridLayout\" bounds=\"[0,0][900,200]\">"
+     "<node text=\"Photo\" bounds=\"[0,0][300,200]\"/>"
+     "<node text=\"Name\" bounds=\"[300,0][600,100]\"/>"
+     "<node text=\"Age\" bounds=\"[600,0][900,100]\"/>"
+     "<node text=\"Ann\" bounds=\"[300,100][600,200]\"/>"
+     "<node text=\"30\" bounds=\"[600,100][900,200]\"/>"
+     "</node></hierarchy>",
+     "Photo\tName\tAge\n"
+     "\tAnn\t30\n"},
+};
+
+// Returns how many cases failed.
+unsigned check_layouts(std::ostream &out) {
+    unsigned failed = 0;
+    for (const LayoutCase &test : LAYOUT_CASES) {
+        XMLDocument doc;
+        std::ostringstream got;
+        if (doc.Parse(test.xml) != XML_SUCCESS || !doc.RootElement()) {
+            got << "(parse error)\n";
+        } else {
+            test.render(doc.RootElement(), got);
+        }
+        if (got.str() == test.expected)
+            continue;
+        failed++;
+        out << "FAILED: " << test.name << "\n"
+            << "Expected:\n" << test.expected << "Got:\n" << got.str();
+    }
+    return failed;
+}
+
+// A screen whose few required features all show must beat a larger
+// signature that the dump only partly matches, however many other
+// features the dump holds, and a dump showing too little of any screen
+// is unknown.
+unsigned check_identify(std::ostream &out) {
+    std::istringstream text("screen dialog\n"
+                            "id app:id/ok\n"
+                            "id app:id/cancel\n"
+                            "screen settings\n"
+                            "id app:id/ok\n"
+                            "id app:id/cancel\n"
+                            "id app:id/wifi\n"
+                            "id app:id/bluetooth\n"
+                            "id app:id/display\n"
+                            "id app:id/sound\n"
+                            "id app:id/battery\n"
+                            "id app:id/storage\n");
+    ScreenLibrary library;
+    std::string error;
+    if (!library.load(text, "library", error)) {
+        out << "FAILED: identify library: " << error << "\n";
+        return 1;
+    }
+
+    struct IdentifyCase {
+        const char *name;
+        const char *xml;
+        const char *expected; // null for unknown
+    };
+    const IdentifyCase cases[] = {
+        {"subset signature beats a larger partial match",
+         "<hierarchy><node class=\"android.widget.FrameLayout\">"
+         "<node resource-id=\"app:id/ok\" class=\"android.widget.Button\"/>"
+         "<node resource-id=\"app:id/cancel\" "
+         "class=\"android.widget.Button\"/>"
+         "<node resource-id=\"app:id/wifi\" class=\"android.widget.Switch\"/>"
+         "<node resource-id=\"app:id/sound\" "
+         "class=\"android.widget.SeekBar\"/>"
+         "<node resource-id=\"app:id/title\" "
+         "class=\"android.widget.TextView\"/>"
+         "<node resource-id=\"app:id/message\" "
+         "class=\"android.widget.TextView\"/>"
+         "</node></hierarchy>",
+         "dialog"},
+        {"too little of any screen is unknown",
+         "<hierarchy><node class=\"android.widget.FrameLayout\">"
+         "<node resource-id=\"app:id/wifi\" class=\"android.widget.Switch\"/>"
+         "</node></hierarchy>",
+         nullptr},
+    };
+
+    unsigned failed = 0;
+    ScreenScratch scratch;
+    std::vector<ScreenMatch> matches;
+    for (const IdentifyCase &test : cases) {
+        XMLDocument doc;
+        doc.Parse(test.xml);
+        library.identify(doc.RootElement(), 1, DEFAULT_MIN_COVERAGE, scratch,
+                         matches);
+        std::string got = matches.empty() ? "unknown" : *matches[0].name;
+        std::string expected = test.expected ? test.expected : "unknown";
+        if (got == expected)
+            continue;
+        failed++;
+        out << "FAILED: " << test.name << "\n"
+            << "Expected: " << expected << "\nGot: " << got << "\n";
+    }
+    return failed;
+}
+
+// Integer keys rank ahead of text keys whichever the direction; only
+// keys of the same kind are reversed by a descending order.
+unsigned check_order(std::ostream &out) {
+    XMLDocument doc;
+    doc.Parse("<hierarchy>"
+              "<node index=\"b\"/><node index=\"7\"/><node index=\"a\"/>"
+              "<node index=\"12\"/><node/><node index=\"-3\"/>"
+              "</hierarchy>");
+    struct OrderCase {
+        const char *key;
+        const char *expected;
+    };
+    const OrderCase cases[] = {
+        {"index", "-3 7 12 a b"},
+        {"-index", "12 7 -3 b a"},
+    };
+
+    unsigned failed = 0;
+    std::vector<const XMLElement *> ranked;
+    for (const OrderCase &test : cases) {
+        OrderKey key;
+        parse_order_key(test.key, key);
+        TopK top(key, 10);
+        for (const XMLElement *node = doc.RootElement()->FirstChildElement();
+             node != nullptr; node = node->NextSiblingElement()) {
+            top.offer(node);
+        }
+        top.take(ranked);
+        std::string got;
+        for (const XMLElement *node : ranked) {
+            if (!got.empty())
+                got += " ";
+            got += node->Attribute("index");
+        }
+        if (got == test.expected)
+            continue;
+        failed++;
+        out << "FAILED: --order-by " << test.key << "\n"
+            << "Expected: " << test.expected << "\nGot: " << got << "\n";
+    }
+    return failed;
+}
+
+} // namespace
+
+int main() {
+    std::ostream &out = std::cout;
+    unsigned failed = check_layouts(out);
+    failed += check_identify(out);
+    failed += check_order(out);
+    if (failed) {
+        out << failed << " check(s) failed\n";
+        return 1;
+    }
+    out << "All checks passed\n";
+    return 0;
+}